@@ -0,0 +1,28 @@
+# The prelude is resolved here, as the function may be
+# called from a subproject with its own PROJECT_SOURCE_DIR.
+set(LISPY_AOT_PRELUDE "${PROJECT_SOURCE_DIR}/stdlib/prelude.lpy")
+
+# lispy_add_aot_executable(<target> <script>)
+#
+# Translates the Lispy script <script> and the prelude in
+# stdlib/ to C with lispyc and builds it into the standalone
+# executable <target>, which does not parse anything when it
+# starts. The C is regenerated whenever <script>, the prelude
+# or lispyc change.
+function(lispy_add_aot_executable target script)
+  get_filename_component(script "${script}" ABSOLUTE)
+  set(prelude "${LISPY_AOT_PRELUDE}")
+  set(source "${CMAKE_CURRENT_BINARY_DIR}/${target}.c")
+
+  add_custom_command(
+      OUTPUT "${source}"
+      COMMAND lispyc --prelude "${prelude}" -o "${source}" "${script}"
+      DEPENDS lispyc "${script}" "${prelude}"
+      COMMENT "Compiling ${script} to C"
+      VERBATIM
+  )
+
+  add_executable("${target}" "${source}")
+  target_compile_features("${target}" PRIVATE c_std_11)
+  target_link_libraries("${target}" PRIVATE lispy_interpreter_lib)
+endfunction()
@@ -26,7 +26,8 @@ lval* builtin(lenv* env, lval* arg, const char* func);
 ///
 /// @details Evaluates the lval `a` as an operator.
 /// Returns an error if `a`'s children are not of type
-/// LVAL_NUM.
+/// LVAL_NUM. The children are reduced left to right
+/// in a single pass, without popping them off `a`.
 ///
 /// @param e - type: lenv*
 /// @param a - type: lval*
@@ -111,8 +112,8 @@ lval* builtin_list(lenv* env, lval* arg);
 /// @brief Evaluates a Q-Expression as an S-Expression.
 ///
 /// @details Evaluates a Q-Expression as an S-Expression
-/// using lval_eval. Returns an error if the Q-Expression
-/// contains another Q-Expression.
+/// using lval_eval_body, without modifying it. Returns an
+/// error if the Q-Expression contains another Q-Expression.
 ///
 /// @param e - type: lenv*
 /// @param a - type: lval*
@@ -217,4 +218,372 @@ lval* builtin_print(lenv* env, lval* arg);
 /// TODO
 lval* builtin_error(lenv* env, lval* arg);
 
+////////////////////////////
+// Builtin Stats functions
+////////////////////////////
+
+/// @brief Reports how symbol lookups were resolved.
+///
+/// @details Returns a Q-Expression alternating the
+/// name and value of each field of lenv_cache_stats,
+/// followed by `hit-rate`, the percentage of lookups
+/// served without a search. Accepts one ignored
+/// argument so it can be called as `(cache-stats ())`.
+///
+/// @param env - type: lenv*
+/// @param arg - type: lval*
+/// @return lval*
+lval* builtin_cache_stats(lenv* env, lval* arg);
+
+////////////////////////////////
+// Builtin Prelude Functions
+////////////////////////////////
+
+/// @brief Checks the arity of a prelude builtin.
+///
+/// @details The builtins below replace lambdas of the
+/// prelude, so they are called and partially applied
+/// like them. Returns NULL if `arg` binds all `total`
+/// `formals` of `func`, the lambda's error if it gives
+/// too many and otherwise a lambda taking the remaining
+/// formals and calling `func` with every argument.
+/// Consumes `arg` unless NULL is returned.
+///
+/// @param func - type: lbuiltin
+/// @param arg - type: lval*
+/// @param formals - type: const char* const*
+/// @param total - type: unsigned
+/// @return lval*
+lval* builtin_arity(lbuiltin func, lval* arg, const char* const* formals, unsigned total);
+
+/// @brief Native `len l` of the prelude.
+///
+/// @details Returns the number of elements of `l`.
+///
+/// @param env - type: lenv*
+/// @param arg - type: lval*
+/// @return lval*
+lval* builtin_len(lenv* env, lval* arg);
+
+/// @brief Native `nth n l` of the prelude.
+///
+/// @details Evaluates the `n`th element of `l`, as `fst` does.
+///
+/// @param env - type: lenv*
+/// @param arg - type: lval*
+/// @return lval*
+lval* builtin_nth(lenv* env, lval* arg);
+
+/// @brief Native `last l` of the prelude.
+///
+/// @details Evaluates the last element of `l`, as `fst` does.
+///
+/// @param env - type: lenv*
+/// @param arg - type: lval*
+/// @return lval*
+lval* builtin_last(lenv* env, lval* arg);
+
+/// @brief Native `reverse l` of the prelude.
+///
+/// @details Returns the elements of `l` in reverse order.
+///
+/// @param env - type: lenv*
+/// @param arg - type: lval*
+/// @return lval*
+lval* builtin_reverse(lenv* env, lval* arg);
+
+/// @brief Native `take n l` of the prelude.
+///
+/// @details Returns the first `n` elements of `l`.
+///
+/// @param env - type: lenv*
+/// @param arg - type: lval*
+/// @return lval*
+lval* builtin_take(lenv* env, lval* arg);
+
+/// @brief Native `drop n l` of the prelude.
+///
+/// @details Returns `l` without its first `n` elements,
+/// sharing its cells.
+///
+/// @param env - type: lenv*
+/// @param arg - type: lval*
+/// @return lval*
+lval* builtin_drop(lenv* env, lval* arg);
+
+/// @brief Native `map f l` of the prelude.
+///
+/// @details Applies `f` to every evaluated element of `l`. As
+/// in the prelude every call is made even after one
+/// of them fails, and the first error is returned.
+///
+/// @param env - type: lenv*
+/// @param arg - type: lval*
+/// @return lval*
+lval* builtin_map(lenv* env, lval* arg);
+
+/// @brief Native `filter f l` of the prelude.
+///
+/// @details Returns the elements of `l` for which `f` returns
+/// a non-zero number, with the same error handling
+/// as builtin_map.
+///
+/// @param env - type: lenv*
+/// @param arg - type: lval*
+/// @return lval*
+lval* builtin_filter(lenv* env, lval* arg);
+
+/// @brief Native `foldl f z l` of the prelude.
+///
+/// @details Folds `l` from the left with `f`, starting at `z`.
+///
+/// @param env - type: lenv*
+/// @param arg - type: lval*
+/// @return lval*
+lval* builtin_foldl(lenv* env, lval* arg);
+
+/// @brief Native `foldr f z l` of the prelude.
+///
+/// @details Folds `l` from the right with `f`, starting at `z`.
+/// Every element is evaluated, in order, before the
+/// first call.
+///
+/// @param env - type: lenv*
+/// @param arg - type: lval*
+/// @return lval*
+lval* builtin_foldr(lenv* env, lval* arg);
+
+/// @brief Native `sum l` of the prelude.
+///
+/// @details Adds the elements of `l` with the builtin `+`.
+///
+/// @param env - type: lenv*
+/// @param arg - type: lval*
+/// @return lval*
+lval* builtin_sum(lenv* env, lval* arg);
+
+/// @brief Native `product l` of the prelude.
+///
+/// @details Multiplies the elements of `l` with the builtin `*`.
+///
+/// @param env - type: lenv*
+/// @param arg - type: lval*
+/// @return lval*
+lval* builtin_product(lenv* env, lval* arg);
+
+/// @brief Native `min & xs` of the prelude.
+///
+/// @details Returns the smallest of the numbers `xs`, the
+/// later one on ties.
+///
+/// @param env - type: lenv*
+/// @param arg - type: lval*
+/// @return lval*
+lval* builtin_min(lenv* env, lval* arg);
+
+/// @brief Native `max & xs` of the prelude.
+///
+/// @details Returns the largest of the numbers `xs`, the later
+/// one on ties.
+///
+/// @param env - type: lenv*
+/// @param arg - type: lval*
+/// @return lval*
+lval* builtin_max(lenv* env, lval* arg);
+
+/// @brief Native `zip x y` of the prelude.
+///
+/// @details Pairs the elements of `x` and `y` up to the length
+/// of the shorter list.
+///
+/// @param env - type: lenv*
+/// @param arg - type: lval*
+/// @return lval*
+lval* builtin_zip(lenv* env, lval* arg);
+
+/// @brief Native `lookup x l` of the prelude.
+///
+/// @details Returns the evaluated value of the first pair in `l`
+/// whose evaluated key equals `x`. Like the prelude,
+/// evaluates the key and value of every pair visited.
+///
+/// @param env - type: lenv*
+/// @param arg - type: lval*
+/// @return lval*
+lval* builtin_lookup(lenv* env, lval* arg);
+
+/// @brief Checks if a name is bound to a builtin.
+///
+/// @details Returns True if the single symbol in the Q-Expression
+/// `arg` is bound to a builtin function. The prelude
+/// uses it to skip the Lispy definition of functions
+/// implemented natively.
+///
+/// @param env - type: lenv*
+/// @param arg - type: lval*
+/// @return lval*
+lval* builtin_native(lenv* env, lval* arg);
+
+////////////////////////////////
+// Unchecked Entry Points
+////////////////////////////////
+
+/// @brief Returns the entry point of `func` that skips its argument checks.
+///
+/// @details The arithmetic and ordering builtins have
+/// entry points without their LASSERT_NUM and LASSERT_TYPE
+/// checks, for callers that have proven every argument is
+/// a number. They read the numbers in place rather than
+/// from an S-Expression and leave them to the caller.
+/// Returns NULL for any other builtin, or if `count`
+/// arguments are not the number `func` takes.
+///
+/// @param func - type: lbuiltin
+/// @param count - type: unsigned
+/// @return lunchecked
+lunchecked builtin_unchecked(lbuiltin func, unsigned count);
+
+////////////////////////////
+// Builtin Special Forms
+////////////////////////////
+
+/// @brief Checks if `func` is a special form.
+///
+/// @details Special forms receive their arguments
+/// unevaluated and evaluate them as needed. Called with
+/// arguments that were already evaluated they behave the
+/// same, as evaluating a value again yields the value.
+///
+/// @param func - type: lbuiltin
+/// @return int
+int builtin_special(lbuiltin func);
+
+/// @brief Evaluates expressions in order.
+///
+/// @details Returns the value of the last expression, or the
+/// first error, skipping the expressions after it.
+///
+/// @param env - type: lenv*
+/// @param arg - type: lval*
+/// @return lval*
+lval* builtin_do(lenv* env, lval* arg);
+
+/// @brief Evaluates a Q-Expression in a new scope.
+///
+/// @details Bindings made by `=` in the body live in a frame of
+/// their own and are dropped once it is evaluated.
+///
+/// @param env - type: lenv*
+/// @param arg - type: lval*
+/// @return lval*
+lval* builtin_let(lenv* env, lval* arg);
+
+/// @brief Evaluates the first clause whose condition holds.
+///
+/// @details Each argument is a clause `{condition expression}`.
+/// Conditions are evaluated in order until one is a
+/// non-zero number, whose expression is then evaluated.
+/// Returns an error if no condition holds.
+///
+/// @param env - type: lenv*
+/// @param arg - type: lval*
+/// @return lval*
+lval* builtin_select(lenv* env, lval* arg);
+
+/// @brief Evaluates the first clause whose key matches.
+///
+/// @details The first argument is compared to the evaluated key
+/// of each clause `{key expression}` in order, and the
+/// expression of the first equal one is evaluated.
+/// Returns an error if no key matches.
+///
+/// @param env - type: lenv*
+/// @param arg - type: lval*
+/// @return lval*
+lval* builtin_case(lenv* env, lval* arg);
+
+/// @brief Short-circuiting logical and.
+///
+/// @details Evaluates numbers in order, returning False at the
+/// first zero without evaluating the rest, and True if
+/// there is none.
+///
+/// @param env - type: lenv*
+/// @param arg - type: lval*
+/// @return lval*
+lval* builtin_and(lenv* env, lval* arg);
+
+/// @brief Short-circuiting logical or.
+///
+/// @details Evaluates numbers in order, returning True at the
+/// first non-zero without evaluating the rest, and False
+/// if there is none.
+///
+/// @param env - type: lenv*
+/// @param arg - type: lval*
+/// @return lval*
+lval* builtin_or(lenv* env, lval* arg);
+
+////////////////////////////
+// Builtin Loops
+////////////////////////////
+
+/// @brief Evaluates a Q-Expression while a condition holds.
+///
+/// @details `(while {condition} {body})` evaluates the body in
+/// the calling scope for as long as the condition is a
+/// non-zero number, so variables are updated with `=`.
+/// Returns the value of the last iteration, {} if there
+/// was none, or the first error.
+///
+/// @param env - type: lenv*
+/// @param arg - type: lval*
+/// @return lval*
+lval* builtin_while(lenv* env, lval* arg);
+
+/// @brief Evaluates a Q-Expression until it stops recurring.
+///
+/// @details `(loop {syms...} vals... {body})` binds each symbol
+/// to its value in a frame of its own and evaluates the
+/// body there. A `recur` in tail position rebinds the
+/// symbols to its arguments in place and starts the next
+/// iteration, and any other value ends the loop. A body
+/// calling `recur` anywhere else, outside of a nested loop
+/// or a Q-Expression it does not evaluate, is an error.
+/// Only the calls written in the body signal the loop, so
+/// a `recur` reached through a lambda or a Q-Expression
+/// built at run time is an error as well.
+///
+/// @param env - type: lenv*
+/// @param arg - type: lval*
+/// @return lval*
+lval* builtin_loop(lenv* env, lval* arg);
+
+/// @brief Reports a `recur` that no `loop` handles.
+///
+/// @details A `loop` handles the `recur` calls in tail
+/// position of its body itself. Any call reaching this
+/// builtin is outside of a loop, or outside of the tail
+/// position of one, and returns an error.
+///
+/// @param env - type: lenv*
+/// @param arg - type: lval*
+/// @return lval*
+lval* builtin_recur(lenv* env, lval* arg);
+
+/// @brief Evaluates a Q-Expression over a range of numbers.
+///
+/// @details `(for-range {sym} start end {body})` binds the
+/// symbol to each number from `start` up to, but not
+/// including, `end` in a frame of its own and evaluates the
+/// body for each. An optional step before the body, which
+/// may be negative, replaces the default of 1. Returns the
+/// value of the last iteration, {} if there was none, or
+/// the first error.
+///
+/// @param env - type: lenv*
+/// @param arg - type: lval*
+/// @return lval*
+lval* builtin_for_range(lenv* env, lval* arg);
+
 #endif /// LISPY_BUILTINS_H
@@ -0,0 +1,203 @@
+#ifndef LISPY_LALLOC_H
+#define LISPY_LALLOC_H
+
+#include <types.h>
+
+#include <stddef.h>
+
+/// @brief Number of pooled size classes for cell arrays.
+///
+/// @details Cell arrays holding up to `1 << (LALLOC_CELL_CLASSES - 1)`
+/// pointers are served from pools. Larger arrays go to the
+/// system allocator.
+#define LALLOC_CELL_CLASSES 7
+
+/// @brief Flag set on lvals and lenvs allocated from a region.
+///
+/// @details Region objects are reclaimed in bulk by
+/// lalloc_region_end so lval_del leaves them untouched.
+#define LALLOC_REGION 1
+
+/// @brief Flag set on released lvals and lenvs still held by a pool or region.
+#define LALLOC_FREE 2
+
+/// @brief Flag set on lenvs allocated from a region.
+#define LALLOC_LENV 4
+
+/// @brief Snapshot of the allocator's bookkeeping.
+///
+/// A `lalloc_stats` consists of a:
+/// - bytes_in_use  : size_t corresponding to the bytes held by live lvals, lenvs and cell arrays
+/// - live_lvals    : size_t corresponding to the number of pooled lvals in use
+/// - slabs         : size_t corresponding to the number of slab pages obtained from the system
+/// - free_lvals    : size_t corresponding to the length of the lval free list
+/// - free_lenvs    : size_t corresponding to the length of the lenv free list
+/// - free_cells    : size_t[] corresponding to the length of each cell array free list
+/// - region_bytes  : size_t corresponding to the bytes bumped in the active region
+typedef struct lalloc_stats {
+    size_t bytes_in_use;
+    size_t region_bytes;
+    size_t live_lvals;
+    size_t slabs;
+    size_t free_lvals;
+    size_t free_lenvs;
+    size_t free_cells[LALLOC_CELL_CLASSES];
+} lalloc_stats;
+
+////////////////////////
+// `lval` Allocation
+////////////////////////
+
+/// @brief Allocates storage for one lval.
+///
+/// @details Allocates uninitialised storage for
+/// one lval from the lval pool, or from the active
+/// region. Only the `flags` member is initialised.
+///
+/// @return lval*
+lval* lalloc_lval(void);
+
+/// @brief Releases storage obtained from lalloc_lval.
+///
+/// @param obj - type: lval*
+void lalloc_lval_free(lval* obj);
+
+////////////////////////
+// `lenv` Allocation
+////////////////////////
+
+/// @brief Allocates storage for one lenv.
+///
+/// @details Allocates uninitialised storage for
+/// one lenv from the lenv pool, or from the active
+/// region. Only the `flags` member is initialised.
+///
+/// @return lenv*
+lenv* lalloc_lenv(void);
+
+/// @brief Releases storage obtained from lalloc_lenv.
+///
+/// @param env - type: lenv*
+void lalloc_lenv_free(lenv* env);
+
+///////////////////////////
+// Cell Array Allocation
+///////////////////////////
+
+/// @brief Allocates an array of `count` pointers.
+///
+/// @details Allocates an uninitialised array able
+/// to hold `count` pointers. Returns NULL when
+/// `count` is zero.
+///
+/// @param count - type: unsigned
+/// @return void*
+void* lalloc_cells(unsigned count);
+
+/// @brief Resizes an array obtained from lalloc_cells.
+///
+/// @details Resizes `cells` from `old_count` to
+/// `new_count` pointers, preserving the leading
+/// elements. Arrays that stay within the same
+/// size class are returned unchanged. The array
+/// stays in the region or heap it came from.
+///
+/// @param cells - type: void*
+/// @param old_count - type: unsigned
+/// @param new_count - type: unsigned
+/// @return void*
+void* lalloc_cells_resize(void* cells, unsigned old_count, unsigned new_count);
+
+/// @brief Releases an array obtained from lalloc_cells.
+///
+/// @param cells - type: void*
+/// @param count - type: unsigned
+void lalloc_cells_free(void* cells, unsigned count);
+
+////////////////////////
+// String Allocation
+////////////////////////
+
+/// @brief Allocates `size` bytes for a string.
+///
+/// @param size - type: size_t
+/// @return char*
+char* lalloc_chars(size_t size);
+
+/// @brief Releases a string obtained from lalloc_chars.
+///
+/// @param str - type: char*
+void lalloc_chars_free(char* str);
+
+//////////////////////
+// Regions
+//////////////////////
+
+/// @brief Enables or disables region mode.
+///
+/// @details Region mode is off by default. While it is
+/// off lalloc_region_begin and lalloc_region_end do
+/// nothing. Has no effect when built with
+/// LISPY_SYSTEM_ALLOC.
+///
+/// @param enabled - type: int
+void lalloc_set_region_mode(int enabled);
+
+/// @brief Checks if allocations currently go to a region.
+///
+/// @return int
+int lalloc_region_active(void);
+
+/// @brief Checks if the active region has overflowed.
+///
+/// @details A region that grows past its limit stops
+/// serving allocations and the rest of the evaluation
+/// uses the pools. Region objects must then release
+/// their children normally since those may be pooled.
+///
+/// @return int
+int lalloc_region_overflowed(void);
+
+/// @brief Starts allocating from a bump region.
+///
+/// @details While a region is active every allocation
+/// is bumped out of the region and freeing region
+/// objects does nothing. Region objects may refer to
+/// heap objects but not the other way around. Regions
+/// nest, only the outermost lalloc_region_end reclaims
+/// memory.
+void lalloc_region_begin(void);
+
+/// @brief Reclaims every object allocated in the region.
+///
+/// @details Releases what the region lvals and lenvs
+/// still hold on the heap (see lval_release and
+/// lenv_del), then resets the region in one step.
+/// Values that must outlive the region have to be
+/// copied out under lalloc_heap_begin beforehand.
+void lalloc_region_end(void);
+
+/// @brief Temporarily allocates from the heap.
+///
+/// @details Suspends the active region until the
+/// matching lalloc_heap_end so values can be
+/// promoted out of it. Calls nest.
+void lalloc_heap_begin(void);
+
+/// @brief Ends a lalloc_heap_begin scope.
+void lalloc_heap_end(void);
+
+//////////////////////
+// Statistics
+//////////////////////
+
+/// @brief Returns the current allocator statistics.
+///
+/// @details Returns the current allocator statistics.
+/// When built with LISPY_SYSTEM_ALLOC only `bytes_in_use`
+/// is tracked.
+///
+/// @return lalloc_stats
+lalloc_stats lalloc_get_stats(void);
+
+#endif /// LISPY_LALLOC_H
@@ -0,0 +1,173 @@
+#ifndef LISPY_LAOT_H
+#define LISPY_LAOT_H
+
+#include <types.h>
+
+/// @brief Support for programs compiled ahead of time by lispyc.
+///
+/// @details lispyc translates a script and the prelude
+/// into C that rebuilds their expressions without parsing
+/// and evaluates them in order. Lambdas defined at the top
+/// level get their bodies compiled to C functions, which
+/// the generated program attaches to them (see lvm_attach)
+/// and which call each other directly while the callee
+/// is still the lambda the call was compiled against.
+
+/// @brief Bytes of native stack nested compiled bodies may use.
+///
+/// @details Compiled bodies recurse on the C stack, so
+/// calls nested deeper than this are run by the VM, which
+/// keeps its frames in the heap, leaving the rest of the
+/// stack to the builtins it calls.
+#define LAOT_STACK_BYTES (1024U * 1024U)
+
+/// @brief Represents an expression of a compiled program.
+///
+/// @details A `laot_node` consists of a:
+/// - type : int corresponding to the type of the lval
+/// - num : long corresponding to the value of a number
+/// - text : const char* corresponding to the text of a symbol, string or error
+/// - first : unsigned corresponding to the offset of the indices of its children
+/// - count : unsigned corresponding to the number of its children
+/// - kept : int corresponding to whether compiled code refers to it
+typedef struct laot_node {
+    int type;
+    long num; // NOLINT(google-runtime-int)
+    const char* text;
+    unsigned first;
+    unsigned count;
+    int kept;
+} laot_node;
+
+//////////////////////
+// Construction
+//////////////////////
+
+/// @brief Builds the expressions of a compiled program.
+///
+/// @details Builds the lval described by each of the
+/// `count` entries of `table` into `nodes`, adding the
+/// children listed in `children` to expressions, so every
+/// child must come before its parent. Nodes that are
+/// `kept` get a reference of their own, which outlives
+/// the expressions they are part of.
+///
+/// @param nodes - type: lval**
+/// @param table - type: const laot_node*
+/// @param children - type: const unsigned*
+/// @param count - type: unsigned
+void laot_build(lval** nodes, const laot_node* table, const unsigned* children, unsigned count);
+
+/// @brief Releases the references laot_build took to `kept` nodes.
+///
+/// @param nodes - type: lval**
+/// @param table - type: const laot_node*
+/// @param count - type: unsigned
+void laot_release(lval** nodes, const laot_node* table, unsigned count);
+
+//////////////////////
+// Evaluation
+//////////////////////
+
+/// @brief Evaluates a top-level expression of a program.
+///
+/// @details Evaluates `expr` as `load` evaluates each
+/// expression of a file, printing it if it evaluates to
+/// an error. Deletes `expr`.
+///
+/// @param env - type: lenv*
+/// @param expr - type: lval*
+void laot_eval(lenv* env, lval* expr);
+
+/// @brief Attaches a compiled body to the lambda bound to `sym`.
+///
+/// @details Does nothing unless `sym` is bound in `env` to
+/// a lambda with compiled code whose body equals `source`,
+/// the body `func` was compiled from, and whose formals
+/// do not include '&'.
+///
+/// @param env - type: lenv*
+/// @param sym - type: lval*
+/// @param source - type: lval*
+/// @param func - type: lnative
+void laot_attach(lenv* env, lval* sym, lval* source, lnative func);
+
+//////////////////////
+// Calls
+//////////////////////
+
+/// @brief Enters a compiled body.
+///
+/// @details Returns 1 if a compiled body may run, which
+/// must then be paired with laot_end, or 0 if running it
+/// would exceed LAOT_STACK_BYTES or lval_max_depth.
+///
+/// @return int
+int laot_begin(void);
+
+/// @brief Leaves a compiled body entered by laot_begin.
+void laot_end(void);
+
+/// @brief Checks if `obj` is the builtin `func`.
+///
+/// @param obj - type: const lval*
+/// @param func - type: lbuiltin
+/// @return int
+int laot_is(const lval* obj, lbuiltin func);
+
+/// @brief Checks if `obj` is a builtin special form.
+///
+/// @param obj - type: const lval*
+/// @return int
+int laot_is_special(const lval* obj);
+
+/// @brief Applies `head` to two arguments.
+///
+/// @details Computes arithmetic and comparisons of two
+/// numbers without building the S-Expression lval_apply
+/// takes, which is used for every other call. Deletes
+/// `head`, `lhs` and `rhs`.
+///
+/// @param env - type: lenv*
+/// @param head - type: lval*
+/// @param lhs - type: lval*
+/// @param rhs - type: lval*
+/// @return lval*
+lval* laot_apply2(lenv* env, lval* head, lval* lhs, lval* rhs);
+
+/// @brief Tests the condition of an inlined `if` or `select`.
+///
+/// @details Returns 1 or 0 if `*cond` is a true or false
+/// number, which is deleted. Otherwise returns -1 and
+/// leaves the error to return in `*cond`, replacing a
+/// value of the wrong type with the error `if` reports.
+///
+/// @param cond - type: lval**
+/// @return int
+int laot_test(lval** cond);
+
+/// @brief Enters a direct call to a compiled body.
+///
+/// @details If the evaluated `sexpr` calls a lambda that
+/// `func` is attached to, none of the arguments is an
+/// error and the lambda has no native code (see
+/// lvm_count_call), deletes `sexpr` and returns a frame
+/// binding them, whose parent is `env`. Returns NULL,
+/// leaving `sexpr`, if it does not or laot_begin refuses
+/// the call, which is then made by lval_apply. `sexpr`
+/// must hold one argument for each formal of the lambda
+/// `func` was compiled from. Every frame returned must
+/// be released with laot_leave.
+///
+/// @param env - type: lenv*
+/// @param sexpr - type: lval*
+/// @param func - type: lnative
+/// @return lenv*
+lenv* laot_enter(lenv* env, lval* sexpr, lnative func);
+
+/// @brief Leaves a direct call entered by laot_enter.
+///
+/// @param frame - type: lenv*
+void laot_leave(lenv* frame);
+
+#endif /// LISPY_LAOT_H
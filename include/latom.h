@@ -0,0 +1,57 @@
+#ifndef LISPY_LATOM_H
+#define LISPY_LATOM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// @brief Represents an interned symbol name
+///
+/// A `latom` consists of a:
+/// - id        : unsigned corresponding to the order in which the atom was interned
+/// - hash      : unsigned corresponding to the hash of the name
+/// - frames    : unsigned corresponding to the number of bindings of the atom in call frames (see lenv.h)
+///
+/// The NUL terminated name is stored directly after the
+/// `latom`. Atoms are never freed, so the name of an atom
+/// is a canonical pointer: two symbols are equal exactly
+/// when their names are the same pointer.
+typedef struct latom {
+    unsigned id;
+    unsigned hash;
+    unsigned frames;
+} latom;
+
+/// @brief Interns the symbol name `name`.
+///
+/// @details Returns the canonical copy of `name`,
+/// creating it on first use.
+///
+/// @param name - type: const char*
+/// @return const char*
+const char* latom_intern(const char* name);
+
+/// @brief Interns the first `len` characters of `name`.
+///
+/// @details Like latom_intern but `name` need not be
+/// NUL terminated.
+///
+/// @param name - type: const char*
+/// @param len - type: size_t
+/// @return const char*
+const char* latom_intern_n(const char* name, size_t len);
+
+/// @brief Returns the atom owning the interned name `sym`.
+///
+/// @param sym - type: const char*
+/// @return latom*
+static inline latom* latom_of(const char* sym)
+{
+    return (latom*)(uintptr_t)sym - 1;
+}
+
+/// @brief Returns the number of atoms interned so far.
+///
+/// @return size_t
+size_t latom_count(void);
+
+#endif /// LISPY_LATOM_H
@@ -7,6 +7,26 @@
 
 #include <stdlib.h>
 
+/// @brief Capacity at which an lenv starts indexing its bindings.
+///
+/// @details Environments with fewer slots (most call
+/// frames) are searched linearly by comparing interned
+/// names. Larger ones, such as the global environment,
+/// are looked up through a hash index.
+#define LENV_INDEX_MIN 16
+
+/// @brief Counts of how lenv_get lookups were resolved.
+///
+/// A `lenv_cache_stats` consists of a:
+/// - slot_hits     : size_t corresponding to lookups found at their resolved slot (see lval_resolve)
+/// - cache_hits    : size_t corresponding to global lookups served by a symbol's inline cache
+/// - misses        : size_t corresponding to lookups that searched the environments by name
+typedef struct lenv_cache_stats {
+    size_t slot_hits;
+    size_t cache_hits;
+    size_t misses;
+} lenv_cache_stats;
+
 ///////////////////////////
 // `lenv` Constructors
 ///////////////////////////
@@ -36,14 +56,22 @@ void lenv_del(lenv* env);
 
 /// @brief Gets an lval from an lenv.
 ///
-/// @details Returns a copy of the lval
-/// `k` from the lenv `env` if it exists
+/// @details Returns a new reference to the
+/// lval `k` from the lenv `env` if it exists
 /// otherwise returns an error.
 ///
+/// Each symbol doubles as an inline cache for its call
+/// site: a global binding found while no call frame
+/// binds the name is remembered in `k` along with the
+/// global version. Until a global binding is added,
+/// replaced or removed, later lookups through `k`
+/// return it without searching. This assumes a single
+/// global environment is in use at a time.
+///
 /// @param e - type: lenv*
 /// @param k - type: lval*
 /// @return lval*
-lval* lenv_get(lenv* env, const lval* key);
+lval* lenv_get(lenv* env, lval* key);
 
 /// TODO
 lenv* lenv_copy(const lenv* env);
@@ -52,7 +80,8 @@ lenv* lenv_copy(const lenv* env);
 ///
 /// @details Sets an lval in an lenv.
 /// Replaces any existing entry with
-/// the same key.
+/// the same key. The lenv takes its own
+/// reference to `v`.
 ///
 /// @param e - type: lenv*
 /// @param k - type: lval*
@@ -62,6 +91,23 @@ void lenv_put(lenv* env, const lval* key, lval* value);
 /// TODO
 void lenv_def(lenv* env, const lval* key, lval* value);
 
+/// @brief Checks if `env` rebinds every name in the frame `frame`.
+///
+/// @details When it does, no lookup starting at `env`
+/// can reach a binding of `frame`, so `env` may take the
+/// parent of `frame` as its own. Global environments are
+/// never shadowed.
+///
+/// @param env - type: const lenv*
+/// @param frame - type: const lenv*
+/// @return int
+int lenv_shadows(const lenv* env, const lenv* frame);
+
+/// @brief Returns how lenv_get lookups have been resolved.
+///
+/// @return lenv_cache_stats
+lenv_cache_stats lenv_get_cache_stats(void);
+
 /// @brief Adds a builtin function to the environment.
 ///
 /// @details Adds a builtin function to the environment
@@ -72,6 +118,21 @@ void lenv_def(lenv* env, const lval* key, lval* value);
 /// @param f - type: lbuiltin
 void lenv_add_builtin(lenv* env, const char* name, lbuiltin func);
 
+/// @brief Chooses between native and Lispy prelude functions.
+///
+/// @details Native builtins for the hot list functions
+/// of the prelude (`len`, `map`, `foldl`, ...) and its
+/// control flow (`do`, `select`, `and`, ...) are
+/// registered by lenv_add_builtins unless disabled
+/// here, in which case the prelude defines its Lispy
+/// versions. Must be set before the builtins are added.
+/// The native builtins do not look up the functions the
+/// Lispy versions call, so only the Lispy versions see
+/// those being redefined.
+///
+/// @param enabled - type: int
+void lenv_set_native_prelude(int enabled);
+
 /// @brief Adds all the builtin functions to the environment.
 ///
 /// @details Adds all the builtin functions to the environment.
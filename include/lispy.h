@@ -3,8 +3,13 @@
 
 #include <builtin.h>
 #include <io.h>
+#include <laot.h>
+#include <lalloc.h>
+#include <latom.h>
 #include <lenv.h>
+#include <ljit.h>
 #include <lval.h>
+#include <lvm.h>
 #include <macros.h>
 #include <parser.h>
 #include <utilities.h>
@@ -0,0 +1,80 @@
+#ifndef LISPY_LJIT_H
+#define LISPY_LJIT_H
+
+#include <types.h>
+
+/// @brief Bytes of native stack a natively compiled call may use.
+///
+/// @details Native code recurses on the C stack, so
+/// self-calls deeper than this allows deoptimize and
+/// are run by the VM instead.
+#define LJIT_STACK_BYTES (256U * 1024U)
+
+/// @brief Number of failed guards after which native code is no longer tried.
+#define LJIT_MAX_DEOPTS 16U
+
+//////////////////////
+// Configuration
+//////////////////////
+
+/// @brief Enables or disables native compilation.
+///
+/// @details Native compilation is on by default but only
+/// available on x86-64 Linux. While it is off, or where
+/// it is unavailable, ljit_compile always returns NULL.
+///
+/// @param enabled - type: int
+void ljit_set_enabled(int enabled);
+
+/// @brief Checks if hot lambdas are compiled to native code.
+///
+/// @return int
+int ljit_enabled(void);
+
+//////////////////////
+// Compilation
+//////////////////////
+
+/// @brief Compiles a lambda to native code.
+///
+/// @details Emits x86-64 machine code into executable
+/// memory from `mmap` for a lambda whose `body` only
+/// uses numbers, its `formals`, the arithmetic and
+/// comparison builtins, `if` and `select` with literal
+/// branches, other symbols bound to numbers, and calls
+/// to itself with every argument. Returns NULL for any
+/// other lambda. The code borrows the symbols of `body`,
+/// which must outlive it.
+///
+/// @param formals - type: const lval*
+/// @param body - type: lval*
+/// @return ljit*
+ljit* ljit_compile(const lval* formals, lval* body);
+
+/// @brief Frees native code.
+///
+/// @param jit - type: ljit*
+void ljit_del(ljit* jit);
+
+//////////////////////
+// Execution
+//////////////////////
+
+/// @brief Runs native code with the arguments bound in `frame`.
+///
+/// @details Checks that every argument is a number, that
+/// the heads of the body, looked up from `frame`, still
+/// name the builtins and lambda it was compiled for and
+/// that its other symbols are bound to numbers. Returns
+/// NULL if a check fails, or if the code deoptimizes
+/// because a division would fail or the recursion would
+/// exceed its native stack or lval_max_depth, so the
+/// caller can evaluate the body itself. The body has no
+/// side effects, so it can always be evaluated again.
+///
+/// @param jit - type: ljit*
+/// @param frame - type: lenv*
+/// @return lval*
+lval* ljit_run(ljit* jit, lenv* frame);
+
+#endif /// LISPY_LJIT_H
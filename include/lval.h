@@ -5,6 +5,65 @@
 #include <lenv.h>
 #include <types.h>
 
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/////////////////////////////
+// Immediate Numbers
+/////////////////////////////
+
+/// @brief Slot of a symbol that has not been resolved.
+#define LVAL_NO_SLOT UINT_MAX
+
+/// @brief Tag bit marking an `lval*` as an immediate number.
+///
+/// @details Heap allocated lvals are always at least
+/// 2-byte aligned so the lowest bit of a real pointer
+/// is never set. Numbers that fit in the remaining
+/// bits are stored directly in the pointer and are
+/// never allocated or freed.
+#define LVAL_FIXNUM_TAG ((uintptr_t)1)
+
+/// @brief Checks if `obj` is an immediate number.
+///
+/// @param obj - type: const lval*
+/// @return int
+static inline int lval_is_fixnum(const lval* obj)
+{
+    return ((uintptr_t)obj & LVAL_FIXNUM_TAG) != 0;
+}
+
+/// @brief Returns the type tag of `obj`.
+///
+/// @details Returns the type tag of `obj`. Immediate
+/// numbers report LVAL_NUM. This must be used instead
+/// of reading `obj->type` directly for any lval that
+/// could be a number.
+///
+/// @param obj - type: const lval*
+/// @return int
+static inline int lval_type(const lval* obj)
+{
+    return lval_is_fixnum(obj) ? (int)LVAL_NUM : (int)obj->type;
+}
+
+/// @brief Returns the value of the number `obj`.
+///
+/// @details Returns the value of the number `obj`
+/// whether it is immediate or heap allocated.
+///
+/// @param obj - type: const lval*
+/// @return long
+static inline long lval_num_value(const lval* obj) // NOLINT(google-runtime-int)
+{
+    if (lval_is_fixnum(obj)) {
+        return (long)((intptr_t)obj >> 1); // NOLINT(google-runtime-int, hicpp-signed-bitwise)
+    }
+
+    return obj->num;
+}
+
 ///////////////////////////
 // `lval` Constructors 
 ///////////////////////////
@@ -13,6 +72,8 @@
 ///
 /// @details Creates an lval of type LVAL_NUM
 /// and sets the obj to the provided number `num`.
+/// Numbers that fit are returned as immediates
+/// and do not allocate.
 ///
 /// @param num - type: const long
 /// @return lval*
@@ -31,13 +92,23 @@ lval* lval_err(const char* fmt, ...);
 /// @brief Creates an lval of type LVAL_SYM.
 ///
 /// @details Creates an lval of type LVAL_SYM
-/// and sets the obj to the provided symbol
-/// or operator l_arg.
+/// and sets the obj to the interned copy of the
+/// provided symbol or operator l_arg.
 ///
 /// @param sym - type: char*
 /// @return lval*
 lval* lval_sym(const char* sym);
 
+/// @brief Creates an lval of type LVAL_SYM.
+///
+/// @details Creates an lval of type LVAL_SYM
+/// from the first `len` characters of `sym`.
+///
+/// @param sym - type: const char*
+/// @param len - type: size_t
+/// @return lval*
+lval* lval_sym_n(const char* sym, size_t len);
+
 /// TODO
 lval* lval_str(const char* str);
 
@@ -82,12 +153,77 @@ lval* lval_lambda(lval* formals, lval* body);
 
 /// @brief Frees an lval.
 ///
-/// @details Frees an lval and all of its children
-/// (if any) as well as any other allocated resources.
+/// @details Releases a reference to an lval. Once the
+/// last reference is released frees the lval and
+/// releases its children (if any) as well as any other
+/// allocated resources.
 ///
 /// @param obj - type: lval*
 void lval_del(lval* obj);
 
+/// @brief Frees an lval whatever its references.
+///
+/// @details Frees `obj` and releases its children (if
+/// any) as well as any other allocated resources, as
+/// lval_del does for the last reference. The outermost
+/// lalloc_region_end calls it on the lvals left in the
+/// region so the heap lvals they borrowed are released.
+///
+/// @param obj - type: lval*
+void lval_release(lval* obj);
+
+/// @brief Releases the cell array of the expression `obj`.
+///
+/// @details Frees the `cell` array of `obj` without
+/// releasing its elements and leaves `obj` empty.
+///
+/// @param obj - type: lval*
+void lval_free_cells(lval* obj);
+
+/////////////////////////////
+// Evaluation Depth
+/////////////////////////////
+
+/// @brief Default limit on the number of nested evaluations.
+///
+/// @details Calls between compiled lambdas keep their
+/// frames on a stack in the heap, and on Linux the
+/// tree-walker goes on in stack segments allocated on the
+/// heap once the native stack runs low, so this limit, not
+/// the native stack, bounds how deep they recurse.
+#define LVAL_MAX_DEPTH 1000000U
+
+/// @brief Sets the limit on the number of nested evaluations.
+///
+/// @param depth - type: unsigned
+void lval_set_max_depth(unsigned depth);
+
+/// @brief Returns the limit on the number of nested evaluations.
+///
+/// @return unsigned
+unsigned lval_max_depth(void);
+
+/// @brief Returns the number of evaluations currently nested.
+///
+/// @return unsigned
+unsigned lval_depth(void);
+
+/// @brief Enters a nested evaluation.
+///
+/// @details Returns NULL, or an error if the evaluation
+/// would exceed the maximum depth. Evaluations that are
+/// `native` recurse on the C stack and also fail once it
+/// is close to exhausted, which lval_eval_sexpr and
+/// lval_eval_body avoid by moving to a new stack segment. Every successful call must be
+/// paired with lval_leave.
+///
+/// @param native - type: int
+/// @return lval*
+lval* lval_enter(int native);
+
+/// @brief Leaves the nested evaluation last entered.
+void lval_leave(void);
+
 //////////////////////
 // `lval` Methods
 //////////////////////
@@ -95,8 +231,9 @@ void lval_del(lval* obj);
 /// @brief Adds the child l_arg to the parent `obj`.
 ///
 /// @details Adds the child l_arg to the parent `obj`.
-/// Allocates memory to `obj`'s `cell` array and
-/// assigns l_arg to the last slot of the array.
+/// Assigns l_arg to the slot after the last element,
+/// doubling the capacity of `obj`'s `cell` array
+/// when it is full.
 ///
 /// @param parent - type: lval*
 /// @param child - type: const lval*
@@ -105,35 +242,103 @@ lval* lval_add(lval* parent, lval* child);
 
 /// @brief Copies an lval.
 ///
-/// @details Copies an lval and all of its children
-/// (if any) as well as any other allocated resources.
+/// @details Copies the top level of an lval. Children
+/// (and a lambda's formals and body) are shared with
+/// `obj` through lval_ref rather than copied. The
+/// copy is never shared.
 ///
 /// @param obj - type: lval*
 /// @return lval*
 lval* lval_copy(const lval* obj);
 
+/// @brief Takes a new reference to an lval.
+///
+/// @details Bumps the reference count of `obj` and
+/// returns it, so the result must be treated as read
+/// only until passed through lval_unshare. Region
+/// lvals borrow heap lvals this way, but a region
+/// lval referenced from the heap, under
+/// lalloc_heap_begin or once the region overflowed,
+/// is copied instead as it cannot outlive the region
+/// (see lalloc.h).
+///
+/// Reference counts alone reclaim every lval. An lval
+/// only gains children while it has a single owner, so
+/// it can never be among them, and lambdas bind their
+/// arguments in fresh frames rather than capturing an
+/// environment, so references never form a cycle.
+///
+/// @param obj - type: lval*
+/// @return lval*
+lval* lval_ref(lval* obj);
+
+/// @brief Makes `obj` safe to mutate.
+///
+/// @details Returns `obj` if it has a single owner and
+/// is not a slice. Otherwise releases the reference to
+/// `obj` and returns an lval_copy of it. Heap lvals are
+/// always copied while a region is active, so they never
+/// come to hold region lvals. Must be called before
+/// modifying an lval obtained from lval_ref.
+///
+/// @param obj - type: lval*
+/// @return lval*
+lval* lval_unshare(lval* obj);
+
 /// @brief Pops the ith element off of the lval `obj`.
 ///
 /// @details Pops the ith element off of the lval `obj`
-/// and moves the receding elements up. Returns the
-/// popped element.
+/// and moves the receding elements up. Popping the
+/// first element moves nothing. Returns the popped
+/// element. `obj` must not be shared.
 ///
 /// @param v - type: lval*
 /// @param ith - type: int
 /// @return lval*
 lval* lval_pop(lval* obj, unsigned ith);
 
+/// @brief Slices the elements of `obj` from `start` on.
+///
+/// @details Returns an expression of the same type as
+/// `obj` viewing its cells from position `start` on,
+/// without copying them. The slice keeps the cells
+/// alive by referencing their owner and is copied by
+/// lval_unshare before being modified. Consumes `obj`,
+/// which may be shared.
+///
+/// @param obj - type: lval*
+/// @param start - type: unsigned
+/// @return lval*
+lval* lval_slice(lval* obj, unsigned start);
+
 /// @brief Takes the ith element off of the lval `obj`.
 ///
 /// @details Takes the ith element off of the lval `obj`
 /// and discards all other objs. Returns the taken
-/// element.
+/// element, which may still be shared.
 ///
 /// @param obj - type: lval*
 /// @param ith - type: int
 /// @return lval*
 lval* lval_take(lval* obj, unsigned ith);
 
+/// @brief Resolves the symbols of a lambda body to frame slots.
+///
+/// @details Sets the `slot` of every symbol in `body`
+/// (including nested expressions) naming one of `formals`
+/// to the position that formal is bound at in the lambda's
+/// frame, and clears it for every other symbol. Lookups
+/// try the slot first in each environment they visit and
+/// fall back to searching by name, so a stale or foreign
+/// slot (such as a Q-Expression evaluated by another
+/// function, or a name defined later) is never wrong,
+/// only slower. As the slot is only a hint it is written
+/// even through shared lvals.
+///
+/// @param formals - type: const lval*
+/// @param body - type: lval*
+void lval_resolve(const lval* formals, lval* body);
+
 /// @brief Evaluates the lval `obj`.
 ///
 /// @details Evaluates the lval `obj`.
@@ -145,7 +350,52 @@ lval* lval_take(lval* obj, unsigned ith);
 /// @return lval*
 lval* lval_eval(lenv* env, lval* obj);
 
-/// TODO
+/// @brief Evaluates `obj` without consuming it.
+///
+/// @details Returns what lval_eval returns for a new
+/// reference to `obj`, reading S-Expressions in place
+/// (see lval_eval_body) instead of copying them. `obj`
+/// must stay alive until the evaluation returns.
+///
+/// @param env - type: lenv*
+/// @param obj - type: lval*
+/// @return lval*
+lval* lval_eval_borrowed(lenv* env, lval* obj);
+
+/// @brief Evaluates the children of `expr` as an S-Expression without consuming it.
+///
+/// @details Lambda bodies and Q-Expressions run by `eval`
+/// or `if` are shared rather than copied for each
+/// evaluation. Their children are evaluated in place into
+/// a new argument list, and an `if` whose branches are
+/// literal Q-Expressions goes on with the taken branch
+/// the same way, so only the parts of `expr` that are
+/// reached are visited. `expr` is never modified and may
+/// be a Q-Expression.
+///
+/// Expressions in tail position, including those of `do`,
+/// `select` and `case`, are evaluated by the same loop,
+/// as are calls in tail position to lambdas without
+/// compiled code and `eval` of a Q-Expression, so tail
+/// recursion runs in constant native stack.
+///
+/// @param env - type: lenv*
+/// @param expr - type: lval*
+/// @return lval*
+lval* lval_eval_body(lenv* env, lval* expr);
+
+/// @brief Calls the function `func` with the arguments `arg`.
+///
+/// @details Binds `arg` to the formals of `func` in a
+/// new frame and evaluates its body there once every
+/// formal is bound, otherwise returns a partial
+/// application recording the arguments given so far.
+/// Lambdas are never modified, so `func` may be shared.
+///
+/// @param env - type: lenv*
+/// @param func - type: lval*
+/// @param arg - type: lval*
+/// @return lval*
 lval* lval_call(lenv* env, lval* func, lval* arg);
 
 /// @brief Evaluates the lval `obj` as an S-Expression.
@@ -160,11 +410,48 @@ lval* lval_call(lenv* env, lval* func, lval* arg);
 /// @return lval*
 lval* lval_eval_sexpr(lenv* env, lval* sexpr);
 
+/// @brief Applies the evaluated S-Expression `sexpr`.
+///
+/// @details Completes lval_eval_sexpr once the children
+/// of `sexpr` have been evaluated: returns the first
+/// error among them, `sexpr` itself if it is empty or its
+/// only child, and otherwise calls the first child with
+/// the rest. `sexpr` must not be shared.
+///
+/// @param env - type: lenv*
+/// @param sexpr - type: lval*
+/// @return lval*
+lval* lval_apply(lenv* env, lval* sexpr);
+
+/// @brief Applies the evaluated S-Expression `sexpr` without entering a compiled lambda.
+///
+/// @details Behaves like lval_apply except when `sexpr`
+/// fully applies a compiled lambda: the arguments are
+/// bound but the body is not run. NULL is returned, the
+/// lambda is stored in `callee` and the frame its
+/// arguments are bound in in `frame`, both now owned by
+/// the caller, with the parent of the frame unset, so
+/// the caller can run the body on its own stack,
+/// possibly in place of its current frame. A call to
+/// the builtin `eval` is followed into the Q-Expression
+/// it evaluates.
+///
+/// @param env - type: lenv*
+/// @param sexpr - type: lval*
+/// @param callee - type: lval**
+/// @param frame - type: lenv**
+/// @return lval*
+lval* lval_apply_enter(lenv* env, lval* sexpr, lval** callee, lenv** frame);
+
 /// @brief Joins the Q-Expression r_arg to l_arg.
 ///
 /// @details Joins the Q-Expression r_arg to l_arg
-/// by continually popping the first element
-/// off r_arg and adding it to l_arg. Returns l_arg.
+/// by adding a reference to each element of r_arg
+/// to l_arg. If r_arg is longer and not shared the
+/// elements of l_arg are prepended to it instead.
+/// Returns the joined Q-Expression, which is the other
+/// operand unchanged, and possibly still shared, when
+/// either operand is empty.
 ///
 /// @param l_arg - type: lval*
 /// @param r_arg - type: lval*
@@ -0,0 +1,125 @@
+#ifndef LISPY_LVM_H
+#define LISPY_LVM_H
+
+#include <types.h>
+
+/// @brief Number of calls after which a lambda is compiled to native code.
+#define LVM_HOT_CALLS 100U
+
+//////////////////////
+// Configuration
+//////////////////////
+
+/// @brief Enables or disables the bytecode VM.
+///
+/// @details The VM is on by default. While it is off
+/// lambdas are created without compiled code and their
+/// bodies are evaluated by the tree-walker, which stays
+/// the reference implementation.
+///
+/// @param enabled - type: int
+void lvm_set_enabled(int enabled);
+
+/// @brief Checks if lambdas are compiled to bytecode.
+///
+/// @return int
+int lvm_enabled(void);
+
+//////////////////////
+// Compilation
+//////////////////////
+
+/// @brief Compiles the body of a lambda.
+///
+/// @details Translates the Q-Expression `body`, evaluated
+/// as an S-Expression, into bytecode. Symbols become
+/// lookups through lenv_get, nested S-Expressions become
+/// calls and every other element is pushed as a constant.
+/// An `if` whose branches are literal Q-Expressions, and
+/// `do`, `and`, `or` and `select` or `case` with literal
+/// clauses, are inlined behind a guard checking that the
+/// head still names the builtin, so redefining it falls
+/// back to a call. Calls of pure builtins such as `+`,
+/// `==` or `tail` on constants are folded into their
+/// value, `(head (tail ... l))` chains are fused into one
+/// indexed access and `==` and `!=` compare without a
+/// call, each behind the same kind of check. The code
+/// keeps a reference to `body` and borrows its elements.
+///
+/// @param body - type: lval*
+/// @return lcode*
+lcode* lvm_compile(lval* body);
+
+/// @brief Attaches a body compiled ahead of time to code.
+///
+/// @details Once attached, lvm_run_native calls `func`
+/// instead of running the bytecode whenever native code
+/// is not available (see laot.h).
+///
+/// @param code - type: lcode*
+/// @param func - type: lnative
+void lvm_attach(lcode* code, lnative func);
+
+/// @brief Returns the body attached to code, or NULL.
+///
+/// @param code - type: const lcode*
+/// @return lnative
+lnative lvm_attached(const lcode* code);
+
+/// @brief Takes a new reference to compiled code.
+///
+/// @param code - type: lcode*
+/// @return lcode*
+lcode* lvm_code_ref(lcode* code);
+
+/// @brief Releases a reference to compiled code.
+///
+/// @details Frees `code` and releases its body once the
+/// last reference is dropped.
+///
+/// @param code - type: lcode*
+void lvm_code_del(lcode* code);
+
+//////////////////////
+// Execution
+//////////////////////
+
+/// @brief Runs compiled code in the environment `env`.
+///
+/// @details Evaluates the body `code` was compiled from
+/// in `env`, producing the same result, errors and side
+/// effects as the tree-walker. Calls to other compiled
+/// lambdas push a frame onto a stack in the heap instead
+/// of recursing, so their depth is bounded by
+/// lval_max_depth rather than the native stack.
+///
+/// @param env - type: lenv*
+/// @param code - type: const lcode*
+/// @return lval*
+lval* lvm_run(lenv* env, const lcode* code);
+
+/// @brief Counts a call to a lambda with code towards LVM_HOT_CALLS.
+///
+/// @details Compiles `func` with ljit_compile on the call
+/// reaching LVM_HOT_CALLS. Returns 1 if later calls should
+/// run its native code, otherwise 0.
+///
+/// @param func - type: const lval*
+/// @return int
+int lvm_count_call(const lval* func);
+
+/// @brief Runs a compiled lambda as native code once it is hot.
+///
+/// @details Counts the call to `func`, a lambda with code,
+/// with lvm_count_call. Returns the result of running
+/// the native code, or else the body attached with
+/// lvm_attach, with the arguments bound in `frame`, or
+/// NULL if `func` has neither or they could not run, in
+/// which case the caller runs the code.
+///
+/// @param func - type: const lval*
+/// @param frame - type: lenv*
+/// @return lval*
+lval* lvm_run_native(const lval* func, lenv* frame);
+
+#endif /// LISPY_LVM_H
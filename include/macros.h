@@ -13,10 +13,10 @@
     }
 
 #define LASSERT_TYPE(func, args, index, expect)                 \
-    LASSERT(args, (args)->cell[index]->type == (expect),        \
+    LASSERT(args, lval_type((args)->cell[index]) == (expect),      \
         "Function '%s' passed incorrect type for argument %i. " \
         "Got %s, Expected %s.",                                 \
-        func, index, ltype_name((args)->cell[index]->type), ltype_name((expect)))
+        func, index, ltype_name(lval_type((args)->cell[index])), ltype_name((expect)))
 
 #define LASSERT_NUM(func, args, num)                           \
     LASSERT(args, (args)->count == (num),                      \
@@ -28,6 +28,14 @@
     LASSERT(args, (args)->cell[index]->count != 0, \
         "Function '%s' passed {} for argument %i.", func, index);
 
+#define LASSERT_ARITY(func, args, formals)                                                \
+    {                                                                                    \
+        lval* partial = builtin_arity(func, args, formals, sizeof(formals) / sizeof(*(formals))); \
+        if (partial) {                                                                   \
+            return partial;                                                              \
+        }                                                                                \
+    }
+
 #define MAX_ERR_STR_SIZE 512
 
 #endif /// LISPY_MACROS_H
@@ -7,34 +7,96 @@ typedef struct lval lval;
 struct lenv;
 typedef struct lenv lenv;
 
+struct lcode;
+typedef struct lcode lcode;
+
+struct ljit;
+typedef struct ljit ljit;
+
 typedef lval* (*lbuiltin)(lenv*, lval*);
 
+/// A lambda body compiled to C, evaluated in the frame binding its arguments (see laot.h).
+typedef lval* (*lnative)(lenv*);
+
+/// An entry point of a builtin without argument checks, borrowing the numbers it is applied to (see builtin_unchecked).
+typedef lval* (*lunchecked)(lval* const*, unsigned);
+
 // typedef lval*(*builtinload)(lenv*, lval*, mpc_parser_t*);
 
 /// @brief Represents a Lisp Value
 ///
-/// A `lval` consists of a:
-/// - type      : int corresponding to an enum value
-/// - num       : long corresponding to a number
-/// - err       : char* corresponding to an error message (optional)
-/// - sym       : char* corresponding to a symbol or operator (optional)
-/// - count     : int corresponding to the number of elements in the `cell` array
-/// - cell      : lval** corresponding to an array of lvals
+/// A `lval` is a tagged union. The `type` tag selects which
+/// members of the anonymous unions hold the value's payload:
+/// - LVAL_NUM              : num       - long corresponding to a number
+/// - LVAL_ERR              : err       - char* corresponding to an error message
+/// - LVAL_SYM              : sym       - const char* corresponding to an interned symbol or operator (see latom.h)
+///                           slot      - unsigned corresponding to the binding position `sym` is expected at (see lval_resolve)
+///                           version   - unsigned corresponding to the global version `cached` was looked up at
+///                           cached    - lval* corresponding to the global binding of `sym`, borrowed (see lenv_get)
+/// - LVAL_STR              : str       - char* corresponding to a string
+/// - LVAL_FUN              : builtin   - lbuiltin, non-NULL for builtin functions
+///                           bound     - lval* holding the arguments a lambda was partially applied to (optional)
+///                           formals   - lval* holding a lambda's parameters, the first `bound->count` of which are bound
+///                           body      - lval* holding a lambda's body
+///                           code      - lcode* holding a lambda's compiled body (optional, see lvm.h)
+/// - LVAL_SEXPR/LVAL_QEXPR : count     - unsigned corresponding to the number of elements in the `cell` array
+///                           capacity  - unsigned corresponding to the number of slots allocated for the array
+///                           cell      - lval** corresponding to an array of lvals
+///                           offset    - unsigned corresponding to the number of unused slots before `cell`
+///                           owner     - lval* corresponding to the expression whose cells a slice shares (optional)
+///
+/// Each anonymous union overlays one member of every type, so
+/// the members of a type never share storage with each other.
+/// Plain anonymous unions, rather than unions of anonymous
+/// structs, keep the header valid ISO C++ for the tests.
+///
+/// Only the members belonging to the tagged type may be read.
+/// `flags` is owned by the allocator (see lalloc.h). `refs` counts
+/// the owners of a shared lval (see lval_ref and lval_unshare).
+///
+/// The elements of an expression live in the middle of a block of
+/// `capacity` slots starting `offset` slots before `cell`, so it can
+/// grow at either end and drop its first element without moving the
+/// others (see lval_add and lval_pop). A slice has an `owner` and
+/// views part of the owner's cells instead of holding its own; it
+/// keeps a reference to the owner rather than to its elements, and
+/// is copied before being modified (see lval_slice).
 typedef struct lval {
-    int type;
+    unsigned char flags;
+    unsigned char type;
+    unsigned int refs;
 
-    long num; // NOLINT(google-runtime-int)
-    char* err;
-    char* sym;
-    char* str;
+    union {
+        long num; // NOLINT(google-runtime-int)
+        char* err;
+        char* str;
+        const char* sym;
+        lbuiltin builtin;
+        struct lval** cell;
+    };
 
-    lbuiltin builtin;
-    lenv* env;
-    lval* formals;
-    lval* body;
+    union {
+        struct lval* cached;
+        struct lval* bound;
+        struct lval* owner;
+    };
 
-    unsigned int count;
-    struct lval** cell;
+    union {
+        unsigned int slot;
+        unsigned int count;
+        struct lval* formals;
+    };
+
+    union {
+        unsigned int version;
+        unsigned int capacity;
+        struct lval* body;
+    };
+
+    union {
+        unsigned int offset;
+        lcode* code;
+    };
 } lval;
 
 /// @brief Enum for possible lval types
@@ -55,12 +117,35 @@ enum { LVAL_ERR,
     LVAL_SEXPR,
     LVAL_QEXPR };
 
+/// @brief Represents an environment of bindings
+///
+/// A `lenv` consists of a:
+/// - flags     : unsigned char owned by the allocator (see lalloc.h)
+/// - frame     : unsigned char set for environments owned by a lambda, as opposed to global ones
+/// - count     : unsigned corresponding to the number of bindings
+/// - capacity  : unsigned corresponding to the length of `syms` and `vals`
+/// - par       : lenv* corresponding to the enclosing environment (optional)
+/// - syms      : const char** corresponding to the bound names, interned
+/// - vals      : lval** corresponding to the bound values
+/// - index     : unsigned* corresponding to a hash index over `syms` (optional)
+///
+/// Small environments are searched linearly. Once `capacity`
+/// reaches LENV_INDEX_MIN the bindings are also indexed by an
+/// open addressed table of `2 * capacity` slots, each holding
+/// a binding's position plus one, or zero when empty.
+///
+/// `flags` leads both lval and lenv so the allocator can
+/// tell live objects from released ones.
 typedef struct lenv {
-    lenv* par;
-
+    unsigned char flags;
+    unsigned char frame;
     unsigned int count;
-    char** syms;
+    unsigned int capacity;
+
+    lenv* par;
+    const char** syms;
     lval** vals;
+    unsigned int* index;
 } lenv;
 
 #endif // LISPY_TYPES_H
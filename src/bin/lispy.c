@@ -5,9 +5,34 @@
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 int main(int argc, char* argv[])
 {
+    int first_arg = 1;
+
+    for (; first_arg < argc && strncmp(argv[first_arg], "--", 2) == 0; ++first_arg) {
+        if (strcmp(argv[first_arg], "--region") == 0) {
+#ifdef LISPY_SYSTEM_ALLOC
+            fprintf(stderr, "Option --region is unavailable with LISPY_SYSTEM_ALLOC\n");
+            return 1;
+#else
+            lalloc_set_region_mode(1);
+#endif
+        } else if (strcmp(argv[first_arg], "--tree-walker") == 0) {
+            lvm_set_enabled(0);
+        } else if (strcmp(argv[first_arg], "--no-jit") == 0) {
+            ljit_set_enabled(0);
+        } else if (strcmp(argv[first_arg], "--lispy-prelude") == 0) {
+            lenv_set_native_prelude(0);
+        } else if (strncmp(argv[first_arg], "--max-depth=", 12) == 0) {
+            lval_set_max_depth((unsigned)strtoul(argv[first_arg] + 12, NULL, 10));
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[first_arg]);
+            return 1;
+        }
+    }
+
     lenv* denv = lenv_new();
     lenv_add_builtins(denv);
     lval* pre = load_prelude(denv);
@@ -15,7 +40,7 @@ int main(int argc, char* argv[])
     Replxx* replxx = replxx_init();
     replxx_install_window_change_handler(replxx);
 
-    if (argc == 1) {
+    if (argc == first_arg) {
 
         puts("Lispy v0.3.1");
         puts("Press Ctrl+D to exit.\n");
@@ -34,21 +59,25 @@ int main(int argc, char* argv[])
             if (*input != '\0') {
                 replxx_history_add(replxx, input);
 
+                lalloc_region_begin();
+
                 int pos = 0;
                 lval* expr = lval_read_expr(input, &pos, '\0');
                 lval* evald_expr = lval_eval(denv, expr);
                 lval_println(evald_expr);
                 lval_del(evald_expr);
+
+                lalloc_region_end();
             }
         }
     }
 
-    if (argc >= 2) {
-        for (int i = 1; i < argc; ++i) {
+    if (argc > first_arg) {
+        for (int i = first_arg; i < argc; ++i) {
             lval* args = lval_add(lval_sexpr(), lval_str(argv[i]));
             lval* loaded = builtin_load(denv, args);
 
-            if (loaded->type == LVAL_ERR) {
+            if (lval_type(loaded) == LVAL_ERR) {
                 lval_println(loaded);
             }
 
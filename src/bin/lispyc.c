@@ -0,0 +1,752 @@
+#include <lispy.h>
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// @brief Translates a Lispy script to a C program.
+///
+/// @details The generated program rebuilds every expression
+/// of the script and the prelude from static tables (see laot_build), so
+/// nothing is parsed when it starts, and evaluates them in
+/// order like `lispy script.lpy`, which loads the prelude
+/// first. The bodies of lambdas defined at the
+/// top level with `fun` or `def` are also translated to C
+/// functions (see laot.h) that call each other directly.
+/// Anything the translation does not cover, such as special
+/// forms and calls to other functions, is left to the
+/// interpreter, so the program behaves as if interpreted.
+
+/// @brief Represents a lambda compiled to a C function.
+///
+/// @details A `lispyc_fn` consists of a:
+/// - name : const char* corresponding to the symbol it is defined as
+/// - sym : lval* corresponding to the symbol node in the definition
+/// - body : lval* corresponding to the body the function is compiled from
+/// - arity : unsigned corresponding to the number of its formals
+/// - form : unsigned corresponding to the top-level expression defining it
+typedef struct lispyc_fn {
+    const char* name;
+    lval* sym;
+    lval* body;
+    unsigned arity;
+    unsigned form;
+} lispyc_fn;
+
+/// @brief Represents a script being translated.
+///
+/// @details A `lispyc` consists of a:
+/// - out : FILE* corresponding to the generated C file
+/// - nodes : lval** corresponding to every expression of the script, children first
+/// - count : unsigned corresponding to the number of nodes
+/// - first : unsigned* corresponding to the offset of the children of each node
+/// - children : unsigned* corresponding to the indices of the children of every expression
+/// - child_count : unsigned corresponding to the number of children
+/// - slots : unsigned* corresponding to a table from nodes to their indices
+/// - mask : unsigned corresponding to the size of the table less one
+/// - kept : unsigned char* corresponding to the nodes compiled code refers to
+/// - fns : lispyc_fn* corresponding to the compiled lambdas
+/// - fn_count : unsigned corresponding to the number of compiled lambdas
+/// - temps : unsigned corresponding to the number of temporaries emitted
+typedef struct lispyc {
+    FILE* out;
+    lval** nodes;
+    unsigned count;
+    unsigned* first;
+    unsigned* children;
+    unsigned child_count;
+    unsigned* slots;
+    unsigned mask;
+    unsigned char* kept;
+    lispyc_fn* fns;
+    unsigned fn_count;
+    unsigned temps;
+} lispyc;
+
+static void* lispyc_alloc(size_t size)
+{
+    void* mem = calloc(1, size ? size : 1);
+
+    if (!mem) {
+        fputs("lispyc: out of memory\n", stderr);
+        exit(1); // NOLINT(concurrency-mt-unsafe)
+    }
+
+    return mem;
+}
+
+//////////////////////
+// Nodes
+//////////////////////
+
+static unsigned lispyc_hash(const lval* obj)
+{
+    uintptr_t key = (uintptr_t)obj;
+    return (unsigned)((key >> 4U) ^ (key >> 16U));
+}
+
+/// @brief Numbers `obj` after its children, returning its index.
+///
+/// @details Only heap values are entered in the table, as
+/// numbers are immediate and the same one can occur twice.
+static unsigned lispyc_number(lispyc* comp, lval* obj)
+{
+    if (lval_type(obj) == LVAL_SEXPR || lval_type(obj) == LVAL_QEXPR) {
+        unsigned* cells = lispyc_alloc(sizeof(unsigned) * obj->count);
+
+        for (unsigned i = 0; i < obj->count; i++) {
+            cells[i] = lispyc_number(comp, obj->cell[i]);
+        }
+
+        comp->first[comp->count] = comp->child_count;
+        memcpy(&comp->children[comp->child_count], cells, sizeof(unsigned) * obj->count);
+        comp->child_count += obj->count;
+        free(cells);
+    }
+
+    if (lval_type(obj) != LVAL_NUM) {
+        unsigned slot = lispyc_hash(obj) & comp->mask;
+
+        while (comp->slots[slot]) {
+            slot = (slot + 1) & comp->mask;
+        }
+
+        comp->slots[slot] = comp->count + 1;
+    }
+
+    comp->nodes[comp->count] = obj;
+    return comp->count++;
+}
+
+static unsigned lispyc_count(const lval* obj)
+{
+    unsigned count = 1;
+
+    if (lval_type(obj) == LVAL_SEXPR || lval_type(obj) == LVAL_QEXPR) {
+        for (unsigned i = 0; i < obj->count; i++) {
+            count += lispyc_count(obj->cell[i]);
+        }
+    }
+
+    return count;
+}
+
+static unsigned lispyc_index(const lispyc* comp, const lval* obj)
+{
+    unsigned slot = lispyc_hash(obj) & comp->mask;
+
+    while (comp->nodes[comp->slots[slot] - 1] != obj) {
+        slot = (slot + 1) & comp->mask;
+    }
+
+    return comp->slots[slot] - 1;
+}
+
+/// @brief Returns the index of a node compiled code refers to.
+static unsigned lispyc_keep(lispyc* comp, const lval* obj)
+{
+    unsigned idx = lispyc_index(comp, obj);
+    comp->kept[idx] = 1;
+    return idx;
+}
+
+static void lispyc_emit_cstr(FILE* out, const char* str)
+{
+    fputc('"', out);
+
+    for (; *str; str++) {
+        unsigned char chr = (unsigned char)*str;
+
+        if (chr == '"' || chr == '\\') {
+            fprintf(out, "\\%c", chr);
+        } else if (chr == '\n') {
+            fputs("\\n", out);
+        } else if (chr == '\t') {
+            fputs("\\t", out);
+        } else if (chr < 0x20U || chr >= 0x7fU || chr == '?') {
+            // Octal escapes avoid trigraphs and hex digits running on.
+            fprintf(out, "\\%03o", chr);
+        } else {
+            fputc(chr, out);
+        }
+    }
+
+    fputc('"', out);
+}
+
+static void lispyc_emit_num(FILE* out, long num) // NOLINT(google-runtime-int)
+{
+    if (num == LONG_MIN) {
+        fputs("LONG_MIN", out);
+    } else {
+        fprintf(out, "%ldL", num);
+    }
+}
+
+/// @brief Emits the entry of `table` describing node `idx`.
+static void lispyc_emit_node(const lispyc* comp, unsigned idx)
+{
+    const lval* obj = comp->nodes[idx];
+    FILE* out = comp->out;
+
+    switch (lval_type(obj)) {
+    case LVAL_NUM:
+        fputs("    { LVAL_NUM, ", out);
+        lispyc_emit_num(out, lval_num_value(obj));
+        fputs(", NULL, 0, 0, ", out);
+        break;
+
+    case LVAL_SYM:
+        fputs("    { LVAL_SYM, 0, ", out);
+        lispyc_emit_cstr(out, obj->sym);
+        fputs(", 0, 0, ", out);
+        break;
+
+    case LVAL_STR:
+        fputs("    { LVAL_STR, 0, ", out);
+        lispyc_emit_cstr(out, obj->str);
+        fputs(", 0, 0, ", out);
+        break;
+
+    case LVAL_ERR:
+        fputs("    { LVAL_ERR, 0, ", out);
+        lispyc_emit_cstr(out, obj->err);
+        fputs(", 0, 0, ", out);
+        break;
+
+    default:
+        fprintf(out, "    { %s, 0, NULL, %u, %u, ",
+            lval_type(obj) == LVAL_SEXPR ? "LVAL_SEXPR" : "LVAL_QEXPR", comp->first[idx], obj->count);
+        break;
+    }
+
+    fprintf(out, "%d },\n", comp->kept[idx]);
+}
+
+/// @brief Emits the indices of the children of every expression.
+static void lispyc_emit_children(const lispyc* comp)
+{
+    FILE* out = comp->out;
+
+    fputs("static const unsigned lispyc_children[] = {", out);
+
+    for (unsigned i = 0; i < comp->child_count; i++) {
+        fputs(i % 16 ? " " : "\n   ", out);
+        fprintf(out, "%u,", comp->children[i]);
+    }
+
+    fputs(comp->child_count ? "\n};\n\n" : "\n    0,\n};\n\n", out);
+}
+
+//////////////////////
+// Definitions
+//////////////////////
+
+static int lispyc_is_sym(const lval* obj, const char* name)
+{
+    return lval_type(obj) == LVAL_SYM && strcmp(obj->sym, name) == 0;
+}
+
+/// @brief Checks that `formals` are symbols, none of them `&`.
+static int lispyc_plain_formals(const lval* formals, unsigned first)
+{
+    for (unsigned i = first; i < formals->count; i++) {
+        if (lval_type(formals->cell[i]) != LVAL_SYM || strcmp(formals->cell[i]->sym, "&") == 0) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/// @brief Records the lambda a top-level form defines, if any.
+///
+/// @details Recognises `(fun {name formals...} {body})`, its
+/// `fallback` form and `(def {name} (\ {formals...} {body}))`.
+static void lispyc_find_fn(lispyc* comp, lval* form, unsigned form_idx)
+{
+    if (lval_type(form) != LVAL_SEXPR || form->count != 3) {
+        return;
+    }
+
+    lval* head = form->cell[0];
+    lval* sig = form->cell[1];
+    lval* def = form->cell[2];
+    lval* sym = NULL;
+    lval* body = NULL;
+    unsigned arity = 0;
+
+    if ((lispyc_is_sym(head, "fun") || lispyc_is_sym(head, "fallback"))
+        && lval_type(sig) == LVAL_QEXPR && sig->count >= 1
+        && lval_type(def) == LVAL_QEXPR && lispyc_plain_formals(sig, 0)) {
+        sym = sig->cell[0];
+        body = def;
+        arity = sig->count - 1;
+    } else if (lispyc_is_sym(head, "def") && lval_type(sig) == LVAL_QEXPR
+        && sig->count == 1 && lval_type(sig->cell[0]) == LVAL_SYM
+        && lval_type(def) == LVAL_SEXPR && def->count == 3
+        && lispyc_is_sym(def->cell[0], "\\") && lval_type(def->cell[1]) == LVAL_QEXPR
+        && lval_type(def->cell[2]) == LVAL_QEXPR && lispyc_plain_formals(def->cell[1], 0)) {
+        sym = sig->cell[0];
+        body = def->cell[2];
+        arity = def->cell[1]->count;
+    } else {
+        return;
+    }
+
+    lispyc_fn* func = &comp->fns[comp->fn_count++];
+    func->name = sym->sym;
+    func->sym = sym;
+    func->body = body;
+    func->arity = arity;
+    func->form = form_idx;
+}
+
+/// @brief Returns the compiled lambda a call to `head` is compiled against.
+///
+/// @details The last definition of a name wins, as the
+/// direct call is only taken while `head` names it.
+static int lispyc_find_callee(const lispyc* comp, const lval* head)
+{
+    if (lval_type(head) != LVAL_SYM) {
+        return -1;
+    }
+
+    for (unsigned i = comp->fn_count; i-- > 0;) {
+        if (strcmp(comp->fns[i].name, head->sym) == 0) {
+            return (int)i;
+        }
+    }
+
+    return -1;
+}
+
+//////////////////////
+// Bodies
+//////////////////////
+
+static void lispyc_indent(const lispyc* comp, int depth)
+{
+    fprintf(comp->out, "%*s", depth * 4, "");
+}
+
+static unsigned lispyc_emit_sexpr(lispyc* comp, lval* sexpr, int depth);
+
+/// @brief Emits the evaluation of `obj` into a new temporary.
+///
+/// @return unsigned - the number of the temporary
+static unsigned lispyc_emit_expr(lispyc* comp, lval* obj, int depth)
+{
+    if (lval_type(obj) == LVAL_SEXPR) {
+        return lispyc_emit_sexpr(comp, obj, depth);
+    }
+
+    unsigned tmp = comp->temps++;
+    lispyc_indent(comp, depth);
+
+    switch (lval_type(obj)) {
+    case LVAL_NUM:
+        fprintf(comp->out, "lval* t%u = lval_num(", tmp);
+        lispyc_emit_num(comp->out, lval_num_value(obj));
+        fputs(");\n", comp->out);
+        break;
+
+    case LVAL_SYM:
+        fprintf(comp->out, "lval* t%u = lenv_get(env, N[%u]);\n", tmp, lispyc_keep(comp, obj));
+        break;
+
+    default:
+        fprintf(comp->out, "lval* t%u = lval_ref(N[%u]);\n", tmp, lispyc_keep(comp, obj));
+        break;
+    }
+
+    return tmp;
+}
+
+static int lispyc_is_branch(const lval* obj)
+{
+    return lval_type(obj) == LVAL_QEXPR;
+}
+
+/// @brief Emits an inlined `(if cond {then} {else})` into `res`.
+static void lispyc_emit_if(lispyc* comp, lval* sexpr, unsigned res, int depth)
+{
+    FILE* out = comp->out;
+    unsigned cond = lispyc_emit_expr(comp, sexpr->cell[1], depth);
+
+    lispyc_indent(comp, depth);
+    fprintf(out, "switch (laot_test(&t%u)) {\n", cond);
+
+    for (int truth = 1; truth >= 0; truth--) {
+        lispyc_indent(comp, depth);
+        fprintf(out, "case %d: {\n", truth);
+        unsigned val = lispyc_emit_sexpr(comp, sexpr->cell[truth ? 2 : 3], depth + 1);
+        lispyc_indent(comp, depth + 1);
+        fprintf(out, "t%u = t%u;\n", res, val);
+        lispyc_indent(comp, depth + 1);
+        fputs("break;\n", out);
+        lispyc_indent(comp, depth);
+        fputs("}\n", out);
+    }
+
+    lispyc_indent(comp, depth);
+    fprintf(out, "default:\n");
+    lispyc_indent(comp, depth + 1);
+    fprintf(out, "t%u = t%u;\n", res, cond);
+    lispyc_indent(comp, depth);
+    fputs("}\n", out);
+}
+
+/// @brief Emits the clauses of an inlined `select` from `ith` on into `res`.
+static void lispyc_emit_select(lispyc* comp, lval* sexpr, unsigned ith, unsigned res, int depth)
+{
+    FILE* out = comp->out;
+
+    if (ith == sexpr->count) {
+        lispyc_indent(comp, depth);
+        fprintf(out, "t%u = lval_err(\"No Selection Found\");\n", res);
+        return;
+    }
+
+    lval* clause = sexpr->cell[ith];
+    unsigned cond = lispyc_emit_expr(comp, clause->cell[0], depth);
+
+    lispyc_indent(comp, depth);
+    fprintf(out, "switch (laot_test(&t%u)) {\n", cond);
+    lispyc_indent(comp, depth);
+    fputs("case 1: {\n", out);
+    unsigned val = lispyc_emit_expr(comp, clause->cell[1], depth + 1);
+    lispyc_indent(comp, depth + 1);
+    fprintf(out, "t%u = t%u;\n", res, val);
+    lispyc_indent(comp, depth + 1);
+    fputs("break;\n", out);
+    lispyc_indent(comp, depth);
+    fputs("}\n", out);
+    lispyc_indent(comp, depth);
+    fputs("case 0: {\n", out);
+    lispyc_emit_select(comp, sexpr, ith + 1, res, depth + 1);
+    lispyc_indent(comp, depth + 1);
+    fputs("break;\n", out);
+    lispyc_indent(comp, depth);
+    fputs("}\n", out);
+    lispyc_indent(comp, depth);
+    fputs("default:\n", out);
+    lispyc_indent(comp, depth + 1);
+    fprintf(out, "t%u = t%u;\n", res, cond);
+    lispyc_indent(comp, depth);
+    fputs("}\n", out);
+}
+
+/// @brief Emits a call, the general case of an S-Expression.
+static void lispyc_emit_call(lispyc* comp, lval* sexpr, unsigned head, unsigned res, int depth)
+{
+    FILE* out = comp->out;
+    int callee = lispyc_find_callee(comp, sexpr->cell[0]);
+
+    // Calls with too few or too many arguments are left to
+    // lval_apply, which partially applies or rejects them.
+    if (callee >= 0 && comp->fns[callee].arity != sexpr->count - 1) {
+        callee = -1;
+    }
+
+    if (callee < 0 && sexpr->count == 3) {
+        unsigned lhs = lispyc_emit_expr(comp, sexpr->cell[1], depth);
+        unsigned rhs = lispyc_emit_expr(comp, sexpr->cell[2], depth);
+        lispyc_indent(comp, depth);
+        fprintf(out, "t%u = laot_apply2(env, t%u, t%u, t%u);\n", res, head, lhs, rhs);
+        return;
+    }
+
+    unsigned args = comp->temps++;
+
+    lispyc_indent(comp, depth);
+    fprintf(out, "lval* t%u = lval_add(lval_sexpr(), t%u);\n", args, head);
+
+    for (unsigned i = 1; i < sexpr->count; i++) {
+        unsigned arg = lispyc_emit_expr(comp, sexpr->cell[i], depth);
+        lispyc_indent(comp, depth);
+        fprintf(out, "lval_add(t%u, t%u);\n", args, arg);
+    }
+
+    if (callee < 0) {
+        lispyc_indent(comp, depth);
+        fprintf(out, "t%u = lval_apply(env, t%u);\n", res, args);
+        return;
+    }
+
+    unsigned frame = comp->temps++;
+
+    lispyc_indent(comp, depth);
+    fprintf(out, "lenv* t%u = laot_enter(env, t%u, lispyc_fn_%d);\n", frame, args, callee);
+    lispyc_indent(comp, depth);
+    fprintf(out, "if (t%u) {\n", frame);
+    lispyc_indent(comp, depth + 1);
+    fprintf(out, "t%u = lispyc_fn_%d(t%u);\n", res, callee, frame);
+    lispyc_indent(comp, depth + 1);
+    fprintf(out, "laot_leave(t%u);\n", frame);
+    lispyc_indent(comp, depth);
+    fputs("} else {\n", out);
+    lispyc_indent(comp, depth + 1);
+    fprintf(out, "t%u = lval_apply(env, t%u);\n", res, args);
+    lispyc_indent(comp, depth);
+    fputs("}\n", out);
+}
+
+/// @brief Emits the evaluation of the children of `sexpr` as an S-Expression.
+///
+/// @details Follows lval_eval_body: an empty expression is
+/// itself, a single child is its value and otherwise the
+/// head is evaluated first, so that `if` and `select` with
+/// literal clauses can be inlined and special forms, which
+/// take their arguments unevaluated, left to the interpreter.
+///
+/// @return unsigned - the number of the temporary holding the result
+static unsigned lispyc_emit_sexpr(lispyc* comp, lval* sexpr, int depth)
+{
+    FILE* out = comp->out;
+
+    if (sexpr->count == 0) {
+        unsigned tmp = comp->temps++;
+        lispyc_indent(comp, depth);
+        fprintf(out, "lval* t%u = lval_sexpr();\n", tmp);
+        return tmp;
+    }
+
+    if (sexpr->count == 1) {
+        return lispyc_emit_expr(comp, sexpr->cell[0], depth);
+    }
+
+    unsigned head = lispyc_emit_expr(comp, sexpr->cell[0], depth);
+    unsigned res = comp->temps++;
+
+    lispyc_indent(comp, depth);
+    fprintf(out, "lval* t%u = NULL;\n", res);
+    lispyc_indent(comp, depth);
+
+    if (sexpr->count == 4 && lispyc_is_branch(sexpr->cell[2]) && lispyc_is_branch(sexpr->cell[3])) {
+        fprintf(out, "if (laot_is(t%u, builtin_if)) {\n", head);
+        lispyc_indent(comp, depth + 1);
+        fprintf(out, "lval_del(t%u);\n", head);
+        lispyc_emit_if(comp, sexpr, res, depth + 1);
+        lispyc_indent(comp, depth);
+        fputs("} else ", out);
+    }
+
+    int select = 1;
+
+    for (unsigned i = 1; i < sexpr->count; i++) {
+        select = select && lispyc_is_branch(sexpr->cell[i]) && sexpr->cell[i]->count >= 2;
+    }
+
+    if (select) {
+        fprintf(out, "if (laot_is(t%u, builtin_select)) {\n", head);
+        lispyc_indent(comp, depth + 1);
+        fprintf(out, "lval_del(t%u);\n", head);
+        lispyc_emit_select(comp, sexpr, 1, res, depth + 1);
+        lispyc_indent(comp, depth);
+        fputs("} else ", out);
+    }
+
+    fprintf(out, "if (laot_is_special(t%u)) {\n", head);
+    lispyc_indent(comp, depth + 1);
+    fprintf(out, "lval_del(t%u);\n", head);
+    lispyc_indent(comp, depth + 1);
+    fprintf(out, "t%u = lval_eval_body(env, N[%u]);\n", res, lispyc_keep(comp, sexpr));
+    lispyc_indent(comp, depth);
+    fputs("} else {\n", out);
+    lispyc_emit_call(comp, sexpr, head, res, depth + 1);
+    lispyc_indent(comp, depth);
+    fputs("}\n", out);
+
+    return res;
+}
+
+//////////////////////
+// Program
+//////////////////////
+
+static void lispyc_emit(lispyc* comp, const unsigned* forms, unsigned form_count, const char* path)
+{
+    FILE* out = comp->out;
+
+    fputs("/* Generated by lispyc from ", out);
+    lispyc_emit_cstr(out, path);
+    fputs(". Do not edit. */\n\n", out);
+    fputs("#include <lispy.h>\n\n#include <limits.h>\n\n", out);
+    fprintf(out, "static lval* N[%u];\n\n", comp->count ? comp->count : 1);
+
+    for (unsigned i = 0; i < comp->fn_count; i++) {
+        fprintf(out, "static lval* lispyc_fn_%u(lenv* env);\n", i);
+    }
+
+    for (unsigned i = 0; i < comp->fn_count; i++) {
+        lispyc_keep(comp, comp->fns[i].sym);
+        lispyc_keep(comp, comp->fns[i].body);
+
+        fprintf(out, "\n/* %s */\nstatic lval* lispyc_fn_%u(lenv* env)\n{\n", comp->fns[i].name, i);
+        unsigned res = lispyc_emit_sexpr(comp, comp->fns[i].body, 1);
+        fprintf(out, "    return t%u;\n}\n", res);
+    }
+
+    fputs("\nstatic const laot_node lispyc_table[] = {\n", out);
+
+    for (unsigned i = 0; i < comp->count; i++) {
+        lispyc_emit_node(comp, i);
+    }
+
+    if (comp->count == 0) {
+        fputs("    { LVAL_SEXPR, 0, NULL, 0, 0, 0 },\n", out);
+    }
+
+    fputs("};\n\n", out);
+    lispyc_emit_children(comp);
+
+    fputs("int main(void)\n{\n", out);
+    fputs("    lenv* env = lenv_new();\n    lenv_add_builtins(env);\n", out);
+    fprintf(out, "    laot_build(N, lispyc_table, lispyc_children, %u);\n\n", comp->count);
+
+    for (unsigned i = 0, next = 0; i < form_count; i++) {
+        fprintf(out, "    laot_eval(env, N[%u]);\n", forms[i]);
+
+        for (; next < comp->fn_count && comp->fns[next].form == i; next++) {
+            fprintf(out, "    laot_attach(env, N[%u], N[%u], lispyc_fn_%u);\n",
+                lispyc_index(comp, comp->fns[next].sym), lispyc_index(comp, comp->fns[next].body), next);
+        }
+    }
+
+    fprintf(out, "\n    laot_release(N, lispyc_table, %u);\n", comp->count);
+    fputs("    lenv_del(env);\n\n    return 0;\n}\n", out);
+}
+
+/// @brief Parses the expressions of the file at `path`.
+///
+/// @return lval* - an S-Expression of them, or NULL after reporting an error
+static lval* lispyc_read(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+
+    if (file == NULL) {
+        fprintf(stderr, "lispyc: could not read %s\n", path);
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    unsigned long length = (unsigned long)ftell(file); // NOLINT(google-runtime-int)
+    fseek(file, 0, SEEK_SET);
+    char* input = lispyc_alloc(length + 1);
+    fread(input, 1, length, file);
+    fclose(file);
+
+    int pos = 0;
+    lval* expr = lval_read_expr(input, &pos, '\0');
+    free(input);
+
+    if (lval_type(expr) == LVAL_ERR) {
+        fprintf(stderr, "lispyc: %s: %s\n", path, expr->err);
+        lval_del(expr);
+        return NULL;
+    }
+
+    return expr;
+}
+
+/// Size of the buffer for the default path of the prelude.
+#define LISPYC_PATH_SIZE 4096
+
+static int lispyc_usage(const char* name)
+{
+    fprintf(stderr, "Usage: %s [--prelude prelude.lpy] [-o out.c] script.lpy\n", name);
+    return 1;
+}
+
+int main(int argc, char* argv[])
+{
+    char default_prelude[LISPYC_PATH_SIZE];
+    const char* prelude_path = default_prelude;
+    const char* out_path = NULL;
+    const char* in_path = NULL;
+
+    // The prelude is found where lispy loads it from.
+    const char* home = getenv("HOME"); // NOLINT(concurrency-mt-unsafe)
+    snprintf(default_prelude, LISPYC_PATH_SIZE, "%s/.lispy/stdlib/prelude.lpy", home ? home : "."); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (strcmp(argv[i], "--prelude") == 0 && i + 1 < argc) {
+            prelude_path = argv[++i];
+        } else if (argv[i][0] == '-' || in_path) {
+            return lispyc_usage(argv[0]);
+        } else {
+            in_path = argv[i];
+        }
+    }
+
+    if (!in_path) {
+        return lispyc_usage(argv[0]);
+    }
+
+    // The prelude is translated with the script, as lispy
+    // would evaluate it first, so neither is parsed at startup.
+    lval* sources[2] = { lispyc_read(prelude_path), NULL };
+
+    if (!sources[0] || !(sources[1] = lispyc_read(in_path))) {
+        if (sources[0]) {
+            lval_del(sources[0]);
+        }
+
+        return 1;
+    }
+
+    lispyc comp = { 0 };
+    unsigned total = lispyc_count(sources[0]) + lispyc_count(sources[1]);
+    unsigned form_count = sources[0]->count + sources[1]->count;
+    unsigned size = 2;
+
+    while (size < total * 2) {
+        size *= 2;
+    }
+
+    comp.nodes = lispyc_alloc(sizeof(lval*) * total);
+    comp.first = lispyc_alloc(sizeof(unsigned) * total);
+    comp.children = lispyc_alloc(sizeof(unsigned) * total);
+    comp.slots = lispyc_alloc(sizeof(unsigned) * size);
+    comp.mask = size - 1;
+    comp.kept = lispyc_alloc(total);
+    comp.fns = lispyc_alloc(sizeof(lispyc_fn) * form_count);
+    unsigned* forms = lispyc_alloc(sizeof(unsigned) * form_count);
+
+    for (unsigned src = 0, form = 0; src < 2; src++) {
+        for (unsigned i = 0; i < sources[src]->count; i++, form++) {
+            forms[form] = lispyc_number(&comp, sources[src]->cell[i]);
+            lispyc_find_fn(&comp, sources[src]->cell[i], form);
+        }
+    }
+
+    comp.out = out_path ? fopen(out_path, "w") : stdout;
+
+    if (!comp.out) {
+        fprintf(stderr, "lispyc: could not write %s\n", out_path);
+        return 1;
+    }
+
+    lispyc_emit(&comp, forms, form_count, in_path);
+
+    if (out_path) {
+        fclose(comp.out);
+    }
+
+    free(comp.nodes);
+    free(comp.first);
+    free(comp.children);
+    free(comp.slots);
+    free(comp.kept);
+    free(comp.fns);
+    free(forms);
+    lval_del(sources[0]);
+    lval_del(sources[1]);
+
+    return 0;
+}
@@ -1,5 +1,8 @@
 #include <builtin.h>
 #include <io.h>
+#include <lalloc.h>
+#include <latom.h>
+#include <lvm.h>
 #include <macros.h>
 #include <parser.h>
 #include <types.h>
@@ -46,49 +49,112 @@ lval* builtin(lenv* env, lval* arg, const char* func)
 // Builtin Operators
 /////////////////////////
 
-lval* builtin_op(lenv* env, lval* arg, const char* operand)
+/// Operators named by the `operand` of builtin_op, builtin_ord and builtin_cmp.
+enum { LOP_ADD,
+    LOP_SUB,
+    LOP_MUL,
+    LOP_DIV,
+    LOP_GT,
+    LOP_LT,
+    LOP_GE,
+    LOP_LE,
+    LOP_EQ,
+    LOP_NE,
+    LOP_UNKNOWN };
+
+/// Names of the operators, indexed by their LOP_ value.
+static const char* const builtin_operators[] = { "+", "-", "*", "/", ">", "<", ">=", "<=", "==", "!=" };
+
+/// Resolves the name of an operator passed to builtin_op, builtin_ord or builtin_cmp.
+///
+/// The builtins bound to each operator name theirs
+/// directly, so only those entry points compare names.
+static int builtin_operator(const char* operand)
 {
-    for (unsigned i = 0; i < arg->count; i++) {
-        LASSERT_TYPE(operand, arg, i, LVAL_NUM)
+    for (int op = 0; op < LOP_UNKNOWN; op++) {
+        if (strcmp(operand, builtin_operators[op]) == 0) {
+            return op;
+        }
     }
 
-    lval* l_expr = lval_pop(arg, 0);
+    return LOP_UNKNOWN;
+}
 
-    if ((strcmp(operand, "-") == 0) && arg->count == 0) {
-        l_expr->num = -l_expr->num;
-    }
+/// Applies the arithmetic operator `op` to `result` and `num`, flagging a division by zero.
+static long builtin_step(int op, long result, long num, int* by_zero) // NOLINT(google-runtime-int)
+{
+    switch (op) {
+    case LOP_ADD:
+        return result + num;
+
+    case LOP_SUB:
+        return result - num;
+
+    case LOP_MUL:
+        return result * num;
+
+    case LOP_DIV:
+        // Reported after the remaining operands are type
+        // checked, as they were checked before any division.
+        if (num == 0) {
+            *by_zero = 1;
+            return result;
+        }
 
-    while (arg->count > 0) {
-        lval* r_expr = lval_pop(arg, 0);
+        return result / num;
 
-        if (strcmp(operand, "+") == 0) {
-            l_expr->num += r_expr->num;
-        }
+    default:
+        return result;
+    }
+}
 
-        if (strcmp(operand, "-") == 0) {
-            l_expr->num -= r_expr->num;
-        }
+/// Returns the value of the reduction `result` of `count` operands by `op`.
+static lval* builtin_op_result(int op, unsigned count, long result, int by_zero) // NOLINT(google-runtime-int)
+{
+    if (op == LOP_SUB && count == 1) {
+        result = -result;
+    }
 
-        if (strcmp(operand, "*") == 0) {
-            l_expr->num *= r_expr->num;
-        }
+    if (by_zero) {
+        return lval_err("Division by zero!");
+    }
 
-        if (strcmp(operand, "/") == 0) {
-            if (r_expr->num == 0) {
-                lval_del(l_expr);
-                lval_del(r_expr);
-                l_expr = lval_err("Division by zero!");
-                break;
-            }
+    return lval_num(result);
+}
 
-            l_expr->num /= r_expr->num;
-        }
+/// Reduces the numbers `arg` with the arithmetic operator `op`.
+static lval* builtin_reduce(lval* arg, int op)
+{
+    const char* operand = builtin_operators[op];
+    int by_zero = 0;
+    long result = 0; // NOLINT(google-runtime-int)
+
+    // Operands are read in place, so a reduction makes a
+    // single pass over `arg` and allocates at most its
+    // result.
+    for (unsigned i = 0; i < arg->count; i++) {
+        LASSERT_TYPE(operand, arg, i, LVAL_NUM)
 
-        lval_del(r_expr);
+        long num = lval_num_value(arg->cell[i]); // NOLINT(google-runtime-int)
+        result = i == 0 ? num : builtin_step(op, result, num, &by_zero);
     }
 
+    unsigned count = arg->count;
     lval_del(arg);
-    return l_expr;
+
+    return builtin_op_result(op, count, result, by_zero);
+}
+
+lval* builtin_op(lenv* env, lval* arg, const char* operand)
+{
+    int op = builtin_operator(operand);
+
+    if (op > LOP_DIV) {
+        lval_del(arg);
+        return lval_err("Unknown function!");
+    }
+
+    return builtin_reduce(arg, op);
 }
 
 ////////////////////////////////////
@@ -97,22 +163,30 @@ lval* builtin_op(lenv* env, lval* arg, const char* operand)
 
 lval* builtin_add(lenv* env, lval* arg)
 {
-    return builtin_op(env, arg, "+");
+    (void)env;
+
+    return builtin_reduce(arg, LOP_ADD);
 }
 
 lval* builtin_sub(lenv* env, lval* arg)
 {
-    return builtin_op(env, arg, "-");
+    (void)env;
+
+    return builtin_reduce(arg, LOP_SUB);
 }
 
 lval* builtin_mul(lenv* env, lval* arg)
 {
-    return builtin_op(env, arg, "*");
+    (void)env;
+
+    return builtin_reduce(arg, LOP_MUL);
 }
 
 lval* builtin_div(lenv* env, lval* arg)
 {
-    return builtin_op(env, arg, "/");
+    (void)env;
+
+    return builtin_reduce(arg, LOP_DIV);
 }
 
 //////////////////////////////
@@ -126,12 +200,10 @@ lval* builtin_head(lenv* env, lval* arg)
     LASSERT_NOT_EMPTY("head", arg, 0)
 
     lval* taken = lval_take(arg, 0);
+    lval* head = lval_add(lval_qexpr(), lval_ref(taken->cell[0]));
+    lval_del(taken);
 
-    while (taken->count > 1) {
-        lval_del(lval_pop(taken, 1));
-    }
-
-    return taken;
+    return head;
 }
 
 lval* builtin_tail(lenv* env, lval* arg)
@@ -141,12 +213,18 @@ lval* builtin_tail(lenv* env, lval* arg)
     LASSERT_NOT_EMPTY("tail", arg, 0)
 
     lval* taken = lval_take(arg, 0);
+
+    if (taken->refs > 1 || taken->owner) {
+        return lval_slice(taken, 1);
+    }
+
     lval_del(lval_pop(taken, 0));
     return taken;
 }
 
 lval* builtin_list(lenv* env, lval* arg)
 {
+    arg = lval_unshare(arg);
     arg->type = LVAL_QEXPR;
     return arg;
 }
@@ -154,11 +232,11 @@ lval* builtin_list(lenv* env, lval* arg)
 lval* builtin_eval(lenv* env, lval* arg)
 {
     LASSERT(arg, arg->count == 1, "Function 'eval' passed too many arguments!")
-    LASSERT(arg, arg->cell[0]->type == LVAL_QEXPR, "Function 'eval' passed incorrect type!")
+    LASSERT(arg, lval_type(arg->cell[0]) == LVAL_QEXPR, "Function 'eval' passed incorrect type!")
 
-    lval* taken = lval_take(arg, 0);
-    taken->type = LVAL_SEXPR;
-    return lval_eval(env, taken);
+    lval* result = lval_eval_body(env, arg->cell[0]);
+    lval_del(arg);
+    return result;
 }
 
 lval* builtin_join(lenv* env, lval* arg)
@@ -199,11 +277,11 @@ lval* builtin_var(lenv* env, lval* arg, const char* func)
     const lval* syms = arg->cell[0];
 
     for (unsigned i = 0; i < syms->count; ++i) {
-        LASSERT(arg, (syms->cell[i]->type == LVAL_SYM),
+        LASSERT(arg, (lval_type(syms->cell[i]) == LVAL_SYM),
             "Function '%s' cannot define non-symbol. "
             "Got %s, Expected %s.",
             func,
-            ltype_name(syms->cell[i]->type),
+            ltype_name(lval_type(syms->cell[i])),
             ltype_name(LVAL_SYM))
     }
 
@@ -233,14 +311,24 @@ lval* builtin_lambda(lenv* env, lval* arg)
     LASSERT_TYPE("\\", arg, 1, LVAL_QEXPR)
 
     for (unsigned i = 0; i < arg->cell[0]->count; i++) {
-        LASSERT(arg, (arg->cell[0]->cell[i]->type == LVAL_SYM),
+        LASSERT(arg, (lval_type(arg->cell[0]->cell[i]) == LVAL_SYM),
             "Cannot define non-symbol. Got %s, Expected %s.",
-            ltype_name(arg->cell[0]->cell[i]->type), ltype_name(LVAL_SYM))
+            ltype_name(lval_type(arg->cell[0]->cell[i])), ltype_name(LVAL_SYM))
+    }
+
+    // Checked once here, so calls can rely on '&' being
+    // second to last if present (see lval_call).
+    for (unsigned i = 0; i < arg->cell[0]->count; i++) {
+        LASSERT(arg, strcmp(arg->cell[0]->cell[i]->sym, "&") != 0 || i + 2 == arg->cell[0]->count,
+            "Function format invalid. "
+            "Symbol '&' not followed by single symbol.")
     }
 
     lval* formals = lval_pop(arg, 0);
     lval* body = lval_pop(arg, 0);
     lval_del(arg);
+
+    lval_resolve(formals, body);
     return lval_lambda(formals, body);
 }
 
@@ -248,84 +336,134 @@ lval* builtin_lambda(lenv* env, lval* arg)
 // Ordering Operators
 //////////////////////////
 
-lval* builtin_ord(lenv* env, lval* arg, const char* operand)
+/// Compares the numbers `lnum` and `rnum` with the ordering operator `op`.
+static int builtin_order(int op, long lnum, long rnum) // NOLINT(google-runtime-int)
 {
-    LASSERT_NUM(operand, arg, 2);
-    LASSERT_TYPE(operand, arg, 0, LVAL_NUM);
-    LASSERT_TYPE(operand, arg, 1, LVAL_NUM);
+    switch (op) {
+    case LOP_GT:
+        return lnum > rnum;
 
-    int rint = 0;
+    case LOP_LT:
+        return lnum < rnum;
 
-    if (strcmp(operand, ">") == 0) {
-        rint = (arg->cell[0]->num > arg->cell[1]->num);
-    }
+    case LOP_GE:
+        return lnum >= rnum;
 
-    if (strcmp(operand, "<") == 0) {
-        rint = (arg->cell[0]->num < arg->cell[1]->num);
-    }
+    case LOP_LE:
+        return lnum <= rnum;
 
-    if (strcmp(operand, ">=") == 0) {
-        rint = (arg->cell[0]->num >= arg->cell[1]->num);
+    default:
+        return 0;
     }
+}
 
-    if (strcmp(operand, "<=") == 0) {
-        rint = (arg->cell[0]->num <= arg->cell[1]->num);
-    }
+/// Compares the two numbers `arg` with the ordering operator `op`.
+static lval* builtin_ordered(lval* arg, int op)
+{
+    const char* operand = builtin_operators[op];
+
+    LASSERT_NUM(operand, arg, 2);
+    LASSERT_TYPE(operand, arg, 0, LVAL_NUM);
+    LASSERT_TYPE(operand, arg, 1, LVAL_NUM);
+
+    int rint = builtin_order(op, lval_num_value(arg->cell[0]), lval_num_value(arg->cell[1]));
 
     lval_del(arg);
     return lval_num(rint);
 }
 
+lval* builtin_ord(lenv* env, lval* arg, const char* operand)
+{
+    int op = builtin_operator(operand);
+
+    if (op < LOP_GT || op > LOP_LE) {
+        lval_del(arg);
+        return lval_err("Unknown function!");
+    }
+
+    return builtin_ordered(arg, op);
+}
+
 lval* builtin_gt(lenv* env, lval* arg)
 {
-    return builtin_ord(env, arg, ">");
+    (void)env;
+
+    return builtin_ordered(arg, LOP_GT);
 }
 
 lval* builtin_lt(lenv* env, lval* arg)
 {
-    return builtin_ord(env, arg, "<");
+    (void)env;
+
+    return builtin_ordered(arg, LOP_LT);
 }
 
 lval* builtin_ge(lenv* env, lval* arg)
 {
-    return builtin_ord(env, arg, ">=");
+    (void)env;
+
+    return builtin_ordered(arg, LOP_GE);
 }
 
 lval* builtin_le(lenv* env, lval* arg)
 {
-    return builtin_ord(env, arg, "<=");
+    (void)env;
+
+    return builtin_ordered(arg, LOP_LE);
 }
 
 //////////////////////////
 // Equality Operators
 //////////////////////////
 
-lval* builtin_cmp(lenv* env, lval* arg, const char* operand)
+/// Compares the two values `arg` with the equality operator `op`.
+static lval* builtin_equal(lval* arg, int op)
 {
-    LASSERT_NUM(operand, arg, 2)
+    LASSERT_NUM(builtin_operators[op], arg, 2)
 
     int result = 0;
 
-    if (strcmp(operand, "==") == 0) {
+    switch (op) {
+    case LOP_EQ:
         result = lval_eq(arg->cell[0], arg->cell[1]);
-    }
+        break;
 
-    if (strcmp(operand, "!=") == 0) {
+    case LOP_NE:
         result = !lval_eq(arg->cell[0], arg->cell[1]);
+        break;
+
+    default:
+        break;
     }
 
     lval_del(arg);
     return lval_num(result);
 }
 
+lval* builtin_cmp(lenv* env, lval* arg, const char* operand)
+{
+    int op = builtin_operator(operand);
+
+    if (op < LOP_EQ || op > LOP_NE) {
+        lval_del(arg);
+        return lval_err("Unknown function!");
+    }
+
+    return builtin_equal(arg, op);
+}
+
 lval* builtin_eq(lenv* env, lval* arg)
 {
-    return builtin_cmp(env, arg, "==");
+    (void)env;
+
+    return builtin_equal(arg, LOP_EQ);
 }
 
 lval* builtin_ne(lenv* env, lval* arg)
 {
-    return builtin_cmp(env, arg, "!=");
+    (void)env;
+
+    return builtin_equal(arg, LOP_NE);
 }
 
 ////////////////////////////
@@ -340,19 +478,9 @@ lval* builtin_if(lenv* env, lval* arg)
     LASSERT_TYPE("if", arg, 1, LVAL_QEXPR)
     LASSERT_TYPE("if", arg, 2, LVAL_QEXPR)
 
-    lval* evald_expr = NULL;
-
-    arg->cell[1]->type = LVAL_SEXPR;
-    arg->cell[2]->type = LVAL_SEXPR;
-
-    if (arg->cell[0]->num) {
-        evald_expr = lval_eval(env, lval_pop(arg, 1));
-    } else {
-        evald_expr = lval_eval(env, lval_pop(arg, 2));
-    }
-
+    lval* result = lval_eval_body(env, arg->cell[lval_num_value(arg->cell[0]) ? 1 : 2]);
     lval_del(arg);
-    return evald_expr;
+    return result;
 }
 
 ////////////////////////////
@@ -383,14 +511,18 @@ lval* builtin_load(lenv* env, lval* arg)
     lval* expr = lval_read_expr(input, &pos, '\0');
     free(input);
 
-    if (expr->type != LVAL_ERR) {
+    if (lval_type(expr) != LVAL_ERR) {
         while (expr->count) {
-            lval* evald_expr = lval_eval(env, lval_pop(expr, 0));
-            if (evald_expr->type == LVAL_ERR) {
+            lalloc_region_begin();
+
+            lval* form = lval_pop(expr, 0);
+            lval* evald_expr = lval_eval(env, form);
+            if (lval_type(evald_expr) == LVAL_ERR) {
                 lval_println(evald_expr);
             }
 
             lval_del(evald_expr);
+            lalloc_region_end();
         }
     } else {
         lval_println(expr);
@@ -428,3 +560,1401 @@ lval* builtin_error(lenv* env, lval* arg)
 
     return err;
 }
+
+////////////////////////////
+// Builtin Stats functions
+////////////////////////////
+
+lval* builtin_cache_stats(lenv* env, lval* arg)
+{
+    LASSERT(arg, arg->count <= 1,
+        "Function 'cache-stats' passed too many arguments. "
+        "Got %i, Expected %i.",
+        arg->count, 1)
+
+    lenv_cache_stats stats = lenv_get_cache_stats();
+    size_t hits = stats.slot_hits + stats.cache_hits;
+    size_t total = hits + stats.misses;
+    lval* qexpr = lval_qexpr();
+
+    lval_add(qexpr, lval_sym("slot-hits"));
+    lval_add(qexpr, lval_num((long)stats.slot_hits)); // NOLINT(google-runtime-int)
+    lval_add(qexpr, lval_sym("cache-hits"));
+    lval_add(qexpr, lval_num((long)stats.cache_hits)); // NOLINT(google-runtime-int)
+    lval_add(qexpr, lval_sym("misses"));
+    lval_add(qexpr, lval_num((long)stats.misses)); // NOLINT(google-runtime-int)
+    lval_add(qexpr, lval_sym("hit-rate"));
+    lval_add(qexpr, lval_num(total ? (long)(hits * 100 / total) : 0)); // NOLINT(google-runtime-int)
+
+    lval_del(arg);
+    return qexpr;
+}
+
+////////////////////////////////
+// Builtin Prelude Functions
+////////////////////////////////
+
+lval* builtin_arity(lbuiltin func, lval* arg, const char* const* formals, unsigned total)
+{
+    if (arg->count > total) {
+        lval* err = lval_err("Function passed too many arguments. "
+                             "Got %i, Expected %i. ",
+            arg->count, total);
+
+        lval_del(arg);
+        return err;
+    }
+
+    if (arg->count == total) {
+        return NULL;
+    }
+
+    // The partial application of a lambda is a lambda
+    // binding the remaining formals, so `func` is wrapped
+    // in one calling it with the arguments given so far.
+    lval* params = lval_qexpr();
+    lval* body = lval_add(lval_qexpr(), lval_fun(func));
+
+    for (unsigned i = 0; i < arg->count; i++) {
+        lval_add(body, lval_ref(arg->cell[i]));
+    }
+
+    for (unsigned i = arg->count; i < total; i++) {
+        lval_add(params, lval_sym(formals[i]));
+        lval_add(body, lval_sym(formals[i]));
+    }
+
+    lval_del(arg);
+    lval_resolve(params, body);
+
+    return lval_lambda(params, body);
+}
+
+/// Returns the error `head` or `tail`, named by `func`, reports for the argument `obj`.
+static lval* builtin_list_err(const char* func, const lval* obj)
+{
+    if (lval_type(obj) != LVAL_QEXPR) {
+        return lval_err("Function '%s' passed incorrect type for argument %i. "
+                        "Got %s, Expected %s.",
+            func, 0, ltype_name(lval_type(obj)), ltype_name(LVAL_QEXPR));
+    }
+
+    return lval_err("Function '%s' passed {} for argument %i.", func, 0);
+}
+
+/// Returns the error `-` reports for the non-number `obj` when counting down.
+static lval* builtin_count_err(const lval* obj)
+{
+    return lval_err("Function '%s' passed incorrect type for argument %i. "
+                    "Got %s, Expected %s.",
+        "-", 0, ltype_name(lval_type(obj)), ltype_name(LVAL_NUM));
+}
+
+/// Evaluates the `ith` element of `list` as `fst` does.
+static lval* builtin_nth_value(lenv* env, const lval* list, unsigned ith)
+{
+    return lval_eval_borrowed(env, list->cell[ith]);
+}
+
+/// Applies `func` to `first` and, unless NULL, `second` as `(func first second)` would.
+static lval* builtin_call(lenv* env, lval* func, lval* first, lval* second)
+{
+    // Functions are called directly, skipping the checks
+    // lval_apply makes before popping the function.
+    int direct = lval_type(func) == LVAL_FUN
+        && lval_type(first) != LVAL_ERR && (!second || lval_type(second) != LVAL_ERR);
+
+    lval* sexpr = direct ? lval_sexpr() : lval_add(lval_sexpr(), lval_ref(func));
+    lval_add(sexpr, first);
+
+    if (second) {
+        lval_add(sexpr, second);
+    }
+
+    return direct ? lval_call(env, func, sexpr) : lval_apply(env, sexpr);
+}
+
+/// Keeps the first error of an eager traversal in `first`, returning whether `obj` was one.
+static int builtin_keep_err(lval** first, lval* obj)
+{
+    if (lval_type(obj) != LVAL_ERR) {
+        return 0;
+    }
+
+    if (*first) {
+        lval_del(obj);
+    } else {
+        *first = obj;
+    }
+
+    return 1;
+}
+
+/// Folds `list` from the left with `func` starting at `init`, as the prelude's `foldl` does.
+static lval* builtin_fold_left(lenv* env, lval* func, lval* init, const lval* list)
+{
+    lval* acc = init;
+
+    for (unsigned i = 0; i < list->count; i++) {
+        lval* value = builtin_nth_value(env, list, i);
+
+        if (lval_type(acc) == LVAL_ERR) {
+            lval_del(value);
+        } else if (lval_type(value) == LVAL_ERR) {
+            lval_del(acc);
+            acc = value;
+        } else {
+            acc = builtin_call(env, func, acc, value);
+        }
+    }
+
+    return acc;
+}
+
+/// Reduces the numbers `arg` to the one `operand` orders first, as the prelude's `min` and `max` do.
+static lval* builtin_extreme(lval* arg, int op)
+{
+    if (arg->count == 0) {
+        lval_del(arg);
+        return lval_err("Function '%s' passed {} for argument %i.", "tail", 0);
+    }
+
+    lval* rest = lval_ref(arg->cell[arg->count - 1]);
+
+    for (unsigned i = arg->count - 1; i-- > 0 && lval_type(rest) != LVAL_ERR;) {
+        lval* item = arg->cell[i];
+        lval* pair = lval_add(lval_add(lval_sexpr(), lval_ref(item)), lval_ref(rest));
+        lval* ordered = builtin_ordered(pair, op);
+
+        if (lval_type(ordered) == LVAL_ERR) {
+            lval_del(rest);
+            rest = ordered;
+        } else {
+            if (lval_num_value(ordered)) {
+                lval_del(rest);
+                rest = lval_ref(item);
+            }
+
+            lval_del(ordered);
+        }
+    }
+
+    lval_del(arg);
+    return rest;
+}
+
+lval* builtin_len(lenv* env, lval* arg)
+{
+    static const char* const formals[] = { "l" };
+    LASSERT_ARITY(builtin_len, arg, formals)
+
+    if (lval_type(arg->cell[0]) != LVAL_QEXPR) {
+        lval* err = builtin_list_err("tail", arg->cell[0]);
+        lval_del(arg);
+        return err;
+    }
+
+    long count = arg->cell[0]->count; // NOLINT(google-runtime-int)
+    lval_del(arg);
+
+    return lval_num(count);
+}
+
+lval* builtin_nth(lenv* env, lval* arg)
+{
+    static const char* const formals[] = { "n", "l" };
+    LASSERT_ARITY(builtin_nth, arg, formals)
+
+    const lval* num = arg->cell[0];
+    const lval* list = arg->cell[1];
+    lval* result = NULL;
+
+    if (lval_type(num) != LVAL_NUM) {
+        result = builtin_count_err(num);
+    } else {
+        long ith = lval_num_value(num); // NOLINT(google-runtime-int)
+
+        if (lval_type(list) == LVAL_QEXPR && ith >= 0 && ith < (long)list->count) { // NOLINT(google-runtime-int)
+            result = builtin_nth_value(env, list, (unsigned)ith);
+        } else if (lval_type(list) != LVAL_QEXPR) {
+            result = builtin_list_err(ith == 0 ? "head" : "tail", list);
+        } else {
+            result = builtin_list_err(ith == (long)list->count ? "head" : "tail", list); // NOLINT(google-runtime-int)
+        }
+    }
+
+    lval_del(arg);
+    return result;
+}
+
+lval* builtin_last(lenv* env, lval* arg)
+{
+    static const char* const formals[] = { "l" };
+    LASSERT_ARITY(builtin_last, arg, formals)
+
+    const lval* list = arg->cell[0];
+    lval* result = NULL;
+
+    if (lval_type(list) != LVAL_QEXPR || list->count == 0) {
+        result = builtin_list_err("tail", list);
+    } else {
+        result = builtin_nth_value(env, list, list->count - 1);
+    }
+
+    lval_del(arg);
+    return result;
+}
+
+lval* builtin_reverse(lenv* env, lval* arg)
+{
+    static const char* const formals[] = { "l" };
+    LASSERT_ARITY(builtin_reverse, arg, formals)
+
+    const lval* list = arg->cell[0];
+
+    if (lval_type(list) != LVAL_QEXPR) {
+        lval* err = builtin_list_err("tail", list);
+        lval_del(arg);
+        return err;
+    }
+
+    lval* reversed = lval_qexpr();
+
+    for (unsigned i = list->count; i-- > 0;) {
+        lval_add(reversed, lval_ref(list->cell[i]));
+    }
+
+    lval_del(arg);
+    return reversed;
+}
+
+lval* builtin_take(lenv* env, lval* arg)
+{
+    static const char* const formals[] = { "n", "l" };
+    LASSERT_ARITY(builtin_take, arg, formals)
+
+    const lval* num = arg->cell[0];
+    const lval* list = arg->cell[1];
+    lval* result = NULL;
+
+    if (lval_type(num) == LVAL_NUM && lval_num_value(num) == 0) {
+        result = lval_qexpr();
+    } else if (lval_type(list) != LVAL_QEXPR || list->count == 0) {
+        result = builtin_list_err("head", list);
+    } else if (lval_type(num) != LVAL_NUM) {
+        result = builtin_count_err(num);
+    } else if (lval_num_value(num) < 0 || lval_num_value(num) > (long)list->count) { // NOLINT(google-runtime-int)
+        result = builtin_list_err("head", list);
+    } else {
+        result = lval_qexpr();
+
+        for (unsigned i = 0; i < (unsigned)lval_num_value(num); i++) {
+            lval_add(result, lval_ref(list->cell[i]));
+        }
+    }
+
+    lval_del(arg);
+    return result;
+}
+
+lval* builtin_drop(lenv* env, lval* arg)
+{
+    static const char* const formals[] = { "n", "l" };
+    LASSERT_ARITY(builtin_drop, arg, formals)
+
+    const lval* num = arg->cell[0];
+    lval* result = NULL;
+
+    if (lval_type(num) == LVAL_NUM && lval_num_value(num) == 0) {
+        result = lval_take(arg, 1);
+    } else if (lval_type(num) != LVAL_NUM) {
+        result = builtin_count_err(num);
+        lval_del(arg);
+    } else if (lval_type(arg->cell[1]) != LVAL_QEXPR
+        || lval_num_value(num) < 0 || lval_num_value(num) > (long)arg->cell[1]->count) { // NOLINT(google-runtime-int)
+        result = builtin_list_err("tail", arg->cell[1]);
+        lval_del(arg);
+    } else {
+        unsigned start = (unsigned)lval_num_value(num);
+        result = lval_slice(lval_take(arg, 1), start);
+    }
+
+    return result;
+}
+
+lval* builtin_map(lenv* env, lval* arg)
+{
+    static const char* const formals[] = { "f", "l" };
+    LASSERT_ARITY(builtin_map, arg, formals)
+
+    lval* func = arg->cell[0];
+    const lval* list = arg->cell[1];
+
+    if (lval_type(list) != LVAL_QEXPR) {
+        lval* err = builtin_list_err("head", list);
+        lval_del(arg);
+        return err;
+    }
+
+    // The prelude's `map` applies `func` to every element
+    // before joining, so calls still happen after an error.
+    lval* mapped = lval_qexpr();
+    lval* err = NULL;
+
+    for (unsigned i = 0; i < list->count; i++) {
+        lval* value = builtin_nth_value(env, list, i);
+
+        if (builtin_keep_err(&err, value)) {
+            continue;
+        }
+
+        lval* result = builtin_call(env, func, value, NULL);
+
+        if (!builtin_keep_err(&err, result)) {
+            lval_add(mapped, result);
+        }
+    }
+
+    lval_del(arg);
+
+    if (err) {
+        lval_del(mapped);
+        return err;
+    }
+
+    return mapped;
+}
+
+lval* builtin_filter(lenv* env, lval* arg)
+{
+    static const char* const formals[] = { "f", "l" };
+    LASSERT_ARITY(builtin_filter, arg, formals)
+
+    lval* func = arg->cell[0];
+    const lval* list = arg->cell[1];
+
+    if (lval_type(list) != LVAL_QEXPR) {
+        lval* err = builtin_list_err("head", list);
+        lval_del(arg);
+        return err;
+    }
+
+    lval* kept = lval_qexpr();
+    lval* err = NULL;
+
+    for (unsigned i = 0; i < list->count; i++) {
+        lval* value = builtin_nth_value(env, list, i);
+
+        if (builtin_keep_err(&err, value)) {
+            continue;
+        }
+
+        lval* cond = builtin_call(env, func, value, NULL);
+
+        if (builtin_keep_err(&err, cond)) {
+            continue;
+        }
+
+        if (lval_type(cond) != LVAL_NUM) {
+            builtin_keep_err(&err,
+                lval_err("Function '%s' passed incorrect type for argument %i. "
+                         "Got %s, Expected %s.",
+                    "if", 0, ltype_name(lval_type(cond)), ltype_name(LVAL_NUM)));
+        } else if (lval_num_value(cond)) {
+            lval_add(kept, lval_ref(list->cell[i]));
+        }
+
+        lval_del(cond);
+    }
+
+    lval_del(arg);
+
+    if (err) {
+        lval_del(kept);
+        return err;
+    }
+
+    return kept;
+}
+
+lval* builtin_foldl(lenv* env, lval* arg)
+{
+    static const char* const formals[] = { "f", "z", "l" };
+    LASSERT_ARITY(builtin_foldl, arg, formals)
+
+    const lval* list = arg->cell[2];
+    lval* result = NULL;
+
+    if (lval_type(list) != LVAL_QEXPR) {
+        result = builtin_list_err("head", list);
+    } else {
+        result = builtin_fold_left(env, arg->cell[0], lval_ref(arg->cell[1]), list);
+    }
+
+    lval_del(arg);
+    return result;
+}
+
+lval* builtin_foldr(lenv* env, lval* arg)
+{
+    static const char* const formals[] = { "f", "z", "l" };
+    LASSERT_ARITY(builtin_foldr, arg, formals)
+
+    lval* func = arg->cell[0];
+    const lval* list = arg->cell[2];
+
+    if (lval_type(list) != LVAL_QEXPR) {
+        lval* err = builtin_list_err("head", list);
+        lval_del(arg);
+        return err;
+    }
+
+    // Every element is evaluated, in order, before the
+    // innermost call, as the recursion in the prelude does.
+    lval* values = lval_qexpr();
+
+    for (unsigned i = 0; i < list->count; i++) {
+        lval_add(values, builtin_nth_value(env, list, i));
+    }
+
+    lval* acc = lval_ref(arg->cell[1]);
+
+    while (values->count) {
+        lval* value = lval_pop(values, values->count - 1);
+
+        if (lval_type(value) == LVAL_ERR) {
+            lval_del(acc);
+            acc = value;
+        } else if (lval_type(acc) == LVAL_ERR) {
+            lval_del(value);
+        } else {
+            acc = builtin_call(env, func, value, acc);
+        }
+    }
+
+    lval_del(values);
+    lval_del(arg);
+
+    return acc;
+}
+
+lval* builtin_sum(lenv* env, lval* arg)
+{
+    static const char* const formals[] = { "l" };
+    LASSERT_ARITY(builtin_sum, arg, formals)
+
+    const lval* list = arg->cell[0];
+    lval* result = NULL;
+
+    if (lval_type(list) != LVAL_QEXPR) {
+        result = builtin_list_err("head", list);
+    } else {
+        lval* add = lval_fun(builtin_add);
+        result = builtin_fold_left(env, add, lval_num(0), list);
+        lval_del(add);
+    }
+
+    lval_del(arg);
+    return result;
+}
+
+lval* builtin_product(lenv* env, lval* arg)
+{
+    static const char* const formals[] = { "l" };
+    LASSERT_ARITY(builtin_product, arg, formals)
+
+    const lval* list = arg->cell[0];
+    lval* result = NULL;
+
+    if (lval_type(list) != LVAL_QEXPR) {
+        result = builtin_list_err("head", list);
+    } else {
+        lval* mul = lval_fun(builtin_mul);
+        result = builtin_fold_left(env, mul, lval_num(1), list);
+        lval_del(mul);
+    }
+
+    lval_del(arg);
+    return result;
+}
+
+lval* builtin_min(lenv* env, lval* arg)
+{
+    (void)env;
+
+    return builtin_extreme(arg, LOP_LT);
+}
+
+lval* builtin_max(lenv* env, lval* arg)
+{
+    (void)env;
+
+    return builtin_extreme(arg, LOP_GT);
+}
+
+lval* builtin_zip(lenv* env, lval* arg)
+{
+    static const char* const formals[] = { "x", "y" };
+    LASSERT_ARITY(builtin_zip, arg, formals)
+
+    const lval* left = arg->cell[0];
+    const lval* right = arg->cell[1];
+    lval* result = NULL;
+
+    if ((lval_type(left) == LVAL_QEXPR && left->count == 0)
+        || (lval_type(right) == LVAL_QEXPR && right->count == 0)) {
+        result = lval_qexpr();
+    } else if (lval_type(left) != LVAL_QEXPR) {
+        result = builtin_list_err("head", left);
+    } else if (lval_type(right) != LVAL_QEXPR) {
+        result = builtin_list_err("head", right);
+    } else {
+        unsigned count = left->count < right->count ? left->count : right->count;
+        result = lval_qexpr();
+
+        for (unsigned i = 0; i < count; i++) {
+            lval* pair = lval_add(lval_qexpr(), lval_ref(left->cell[i]));
+            lval_add(result, lval_add(pair, lval_ref(right->cell[i])));
+        }
+    }
+
+    lval_del(arg);
+    return result;
+}
+
+/// Evaluates the `ith` element of the pair `entry` evaluates to, as `fst (fst l)` and `snd (fst l)` do.
+static lval* builtin_entry_value(lenv* env, lval* entry, unsigned ith)
+{
+    lval* pair = lval_eval(env, lval_ref(entry));
+    lval* result = NULL;
+
+    if (lval_type(pair) == LVAL_ERR) {
+        return pair;
+    }
+
+    if (lval_type(pair) != LVAL_QEXPR || pair->count == 0) {
+        result = builtin_list_err(ith ? "tail" : "head", pair);
+    } else if (pair->count <= ith) {
+        result = builtin_list_err("head", pair);
+    } else {
+        result = builtin_nth_value(env, pair, ith);
+    }
+
+    lval_del(pair);
+    return result;
+}
+
+lval* builtin_lookup(lenv* env, lval* arg)
+{
+    static const char* const formals[] = { "x", "l" };
+    LASSERT_ARITY(builtin_lookup, arg, formals)
+
+    lval* key = arg->cell[0];
+    const lval* list = arg->cell[1];
+
+    if (lval_type(list) != LVAL_QEXPR) {
+        lval* err = builtin_list_err("head", list);
+        lval_del(arg);
+        return err;
+    }
+
+    // `do` evaluates the key and value of every entry it
+    // visits, returning the first error before comparing.
+    for (unsigned i = 0; i < list->count; i++) {
+        lval* found = builtin_entry_value(env, list->cell[i], 0);
+        lval* value = builtin_entry_value(env, list->cell[i], 1);
+
+        if (lval_type(found) == LVAL_ERR || lval_type(value) == LVAL_ERR) {
+            lval* err = lval_type(found) == LVAL_ERR ? found : value;
+            lval_del(err == found ? value : found);
+            lval_del(arg);
+            return err;
+        }
+
+        int match = lval_eq(found, key);
+        lval_del(found);
+
+        if (match) {
+            lval_del(arg);
+            return value;
+        }
+
+        lval_del(value);
+    }
+
+    lval_del(arg);
+    return lval_err("No Element Found");
+}
+
+lval* builtin_native(lenv* env, lval* arg)
+{
+    LASSERT_NUM("native", arg, 1)
+    LASSERT_TYPE("native", arg, 0, LVAL_QEXPR)
+    LASSERT_NOT_EMPTY("native", arg, 0)
+    LASSERT(arg, lval_type(arg->cell[0]->cell[0]) == LVAL_SYM,
+        "Function '%s' passed incorrect type for argument %i. "
+        "Got %s, Expected %s.",
+        "native", 0, ltype_name(lval_type(arg->cell[0]->cell[0])), ltype_name(LVAL_SYM))
+
+    lval* value = lenv_get(env, arg->cell[0]->cell[0]);
+    int native = lval_type(value) == LVAL_FUN && value->builtin != NULL;
+
+    lval_del(value);
+    lval_del(arg);
+
+    return lval_num(native);
+}
+
+////////////////////////////////
+// Unchecked Entry Points
+////////////////////////////////
+
+/// Reduces the `count` numbers `args` by `op` without checking them.
+static lval* builtin_op_unchecked(lval* const* args, unsigned count, int op)
+{
+    int by_zero = 0;
+    long result = lval_num_value(args[0]); // NOLINT(google-runtime-int)
+
+    for (unsigned i = 1; i < count; i++) {
+        result = builtin_step(op, result, lval_num_value(args[i]), &by_zero);
+    }
+
+    return builtin_op_result(op, count, result, by_zero);
+}
+
+static lval* builtin_add_unchecked(lval* const* args, unsigned count)
+{
+    return builtin_op_unchecked(args, count, LOP_ADD);
+}
+
+static lval* builtin_sub_unchecked(lval* const* args, unsigned count)
+{
+    return builtin_op_unchecked(args, count, LOP_SUB);
+}
+
+static lval* builtin_mul_unchecked(lval* const* args, unsigned count)
+{
+    return builtin_op_unchecked(args, count, LOP_MUL);
+}
+
+static lval* builtin_div_unchecked(lval* const* args, unsigned count)
+{
+    return builtin_op_unchecked(args, count, LOP_DIV);
+}
+
+static lval* builtin_gt_unchecked(lval* const* args, unsigned count)
+{
+    (void)count;
+
+    return lval_num(builtin_order(LOP_GT, lval_num_value(args[0]), lval_num_value(args[1])));
+}
+
+static lval* builtin_lt_unchecked(lval* const* args, unsigned count)
+{
+    (void)count;
+
+    return lval_num(builtin_order(LOP_LT, lval_num_value(args[0]), lval_num_value(args[1])));
+}
+
+static lval* builtin_ge_unchecked(lval* const* args, unsigned count)
+{
+    (void)count;
+
+    return lval_num(builtin_order(LOP_GE, lval_num_value(args[0]), lval_num_value(args[1])));
+}
+
+static lval* builtin_le_unchecked(lval* const* args, unsigned count)
+{
+    (void)count;
+
+    return lval_num(builtin_order(LOP_LE, lval_num_value(args[0]), lval_num_value(args[1])));
+}
+
+lunchecked builtin_unchecked(lbuiltin func, unsigned count)
+{
+    static const struct {
+        lbuiltin checked;
+        lunchecked unchecked;
+        unsigned count;
+    } entries[] = {
+        { builtin_add, builtin_add_unchecked, 0 },
+        { builtin_sub, builtin_sub_unchecked, 0 },
+        { builtin_mul, builtin_mul_unchecked, 0 },
+        { builtin_div, builtin_div_unchecked, 0 },
+        { builtin_gt, builtin_gt_unchecked, 2 },
+        { builtin_lt, builtin_lt_unchecked, 2 },
+        { builtin_ge, builtin_ge_unchecked, 2 },
+        { builtin_le, builtin_le_unchecked, 2 },
+    };
+
+    for (unsigned i = 0; i < sizeof(entries) / sizeof(entries[0]); i++) {
+        if (entries[i].checked == func) {
+            return count > 0 && (entries[i].count == 0 || entries[i].count == count) ? entries[i].unchecked : NULL;
+        }
+    }
+
+    return NULL;
+}
+
+////////////////////////////
+// Builtin Special Forms
+////////////////////////////
+
+int builtin_special(lbuiltin func)
+{
+    return func == builtin_do || func == builtin_let
+        || func == builtin_select || func == builtin_case
+        || func == builtin_and || func == builtin_or;
+}
+
+lval* builtin_do(lenv* env, lval* arg)
+{
+    lval* result = lval_qexpr();
+
+    for (unsigned i = 0; i < arg->count && lval_type(result) != LVAL_ERR; i++) {
+        lval_del(result);
+        result = lval_eval_borrowed(env, arg->cell[i]);
+    }
+
+    lval_del(arg);
+    return result;
+}
+
+lval* builtin_let(lenv* env, lval* arg)
+{
+    LASSERT_NUM("let", arg, 1)
+
+    lval* body = lval_eval_borrowed(env, arg->cell[0]);
+    lval_del(arg);
+
+    if (lval_type(body) == LVAL_ERR) {
+        return body;
+    }
+
+    if (lval_type(body) != LVAL_QEXPR) {
+        lval* err = lval_err("Function '%s' passed incorrect type for argument %i. "
+                             "Got %s, Expected %s.",
+            "let", 0, ltype_name(lval_type(body)), ltype_name(LVAL_QEXPR));
+
+        lval_del(body);
+        return err;
+    }
+
+    // The scope is a frame of its own, so bindings made
+    // with `=` are dropped once the body is evaluated.
+    lenv* scope = lenv_new();
+    scope->frame = 1;
+    scope->par = env;
+
+    lval* result = lval_eval_body(scope, body);
+    lval_del(body);
+    lenv_del(scope);
+
+    return result;
+}
+
+/// Evaluates the `ith` element of the clause `clause` for `select` and `case`.
+static lval* builtin_clause_value(lenv* env, const lval* clause, unsigned ith)
+{
+    if (lval_type(clause) != LVAL_QEXPR || clause->count == 0) {
+        return builtin_list_err(ith ? "tail" : "head", clause);
+    }
+
+    if (clause->count <= ith) {
+        return builtin_list_err("head", clause);
+    }
+
+    return builtin_nth_value(env, clause, ith);
+}
+
+/// Evaluates the `ith` argument of `select` or `case` to a clause, which is stored in
+/// `owned` unless the argument is a literal Q-Expression, read in place instead.
+static lval* builtin_clause(lenv* env, lval* arg, unsigned ith, lval** owned)
+{
+    *owned = lval_type(arg->cell[ith]) == LVAL_QEXPR ? NULL : lval_eval_borrowed(env, arg->cell[ith]);
+    return *owned ? *owned : arg->cell[ith];
+}
+
+lval* builtin_select(lenv* env, lval* arg)
+{
+    for (unsigned i = 0; i < arg->count; i++) {
+        lval* owned = NULL;
+        lval* clause = builtin_clause(env, arg, i, &owned);
+
+        if (lval_type(clause) == LVAL_ERR) {
+            lval_del(arg);
+            return owned;
+        }
+
+        lval* cond = builtin_clause_value(env, clause, 0);
+        lval* result = NULL;
+
+        if (lval_type(cond) == LVAL_NUM && lval_num_value(cond) != 0) {
+            result = builtin_clause_value(env, clause, 1);
+        } else if (lval_type(cond) == LVAL_ERR) {
+            result = lval_ref(cond);
+        } else if (lval_type(cond) != LVAL_NUM) {
+            result = lval_err("Function '%s' passed incorrect type for argument %i. "
+                              "Got %s, Expected %s.",
+                "if", 0, ltype_name(lval_type(cond)), ltype_name(LVAL_NUM));
+        }
+
+        lval_del(cond);
+
+        if (owned) {
+            lval_del(owned);
+        }
+
+        if (result) {
+            lval_del(arg);
+            return result;
+        }
+    }
+
+    lval_del(arg);
+    return lval_err("No Selection Found");
+}
+
+lval* builtin_case(lenv* env, lval* arg)
+{
+    LASSERT(arg, arg->count > 0,
+        "Function '%s' passed incorrect number of arguments. "
+        "Got %i, Expected %i.",
+        "case", arg->count, 1)
+
+    lval* key = lval_eval_borrowed(env, arg->cell[0]);
+
+    for (unsigned i = 1; i < arg->count && lval_type(key) != LVAL_ERR; i++) {
+        lval* owned = NULL;
+        lval* clause = builtin_clause(env, arg, i, &owned);
+        lval* found = clause;
+
+        if (lval_type(clause) != LVAL_ERR) {
+            found = builtin_clause_value(env, clause, 0);
+        }
+
+        if (lval_type(found) == LVAL_ERR) {
+            lval_del(key);
+            key = lval_ref(found);
+        } else if (lval_eq(key, found)) {
+            lval* result = builtin_clause_value(env, clause, 1);
+
+            lval_del(found);
+
+            if (owned) {
+                lval_del(owned);
+            }
+
+            lval_del(key);
+            lval_del(arg);
+            return result;
+        }
+
+        if (found != clause) {
+            lval_del(found);
+        }
+
+        if (owned) {
+            lval_del(owned);
+        }
+    }
+
+    lval_del(arg);
+
+    if (lval_type(key) == LVAL_ERR) {
+        return key;
+    }
+
+    lval_del(key);
+    return lval_err("No Case Found");
+}
+
+/// Evaluates the conditions in `arg` until one is `stop`, as `and` and `or`, named by `func`, do.
+static lval* builtin_logic(lenv* env, lval* arg, const char* func, int stop)
+{
+    for (unsigned i = 0; i < arg->count; i++) {
+        lval* cond = lval_eval_borrowed(env, arg->cell[i]);
+
+        if (lval_type(cond) == LVAL_NUM && (lval_num_value(cond) != 0) != stop) {
+            lval_del(cond);
+            continue;
+        }
+
+        lval_del(arg);
+
+        if (lval_type(cond) == LVAL_ERR) {
+            return cond;
+        }
+
+        if (lval_type(cond) != LVAL_NUM) {
+            lval* err = lval_err("Function '%s' passed incorrect type for argument %i. "
+                                 "Got %s, Expected %s.",
+                func, i, ltype_name(lval_type(cond)), ltype_name(LVAL_NUM));
+
+            lval_del(cond);
+            return err;
+        }
+
+        lval_del(cond);
+        return lval_num(stop);
+    }
+
+    lval_del(arg);
+    return lval_num(!stop);
+}
+
+lval* builtin_and(lenv* env, lval* arg)
+{
+    return builtin_logic(env, arg, "and", 0);
+}
+
+lval* builtin_or(lenv* env, lval* arg)
+{
+    return builtin_logic(env, arg, "or", 1);
+}
+
+////////////////////////////
+// Builtin Loops
+////////////////////////////
+
+/// Value returned by the `recur` calls of a loop body, which signals the loop while `recur_args` holds the values for the next iteration.
+///
+/// It is told apart by its address. Being an error, it ends
+/// the evaluation of anything it is passed to, so it can
+/// only ever be the value of the body or be reported.
+static char recur_message[] = "Function 'recur' called outside of tail position of 'loop'.";
+static lval recur_signal = { .type = LVAL_ERR, .refs = 1, .err = recur_message };
+static lval* recur_args = NULL;
+
+static lval* builtin_loop_recur(lenv* env, lval* arg);
+
+/// Function that the `recur` calls in tail position of a loop body are pointed at.
+static lval loop_recur = { .type = LVAL_FUN, .refs = 1, .builtin = builtin_loop_recur };
+
+/// Number of `loop` bodies being evaluated.
+static unsigned loops = 0;
+
+/// Compiles the Q-Expression `body` to evaluate it repeatedly, or returns NULL if it is walked.
+static lcode* builtin_loop_code(lval* body)
+{
+    return lvm_enabled() ? lvm_compile(body) : NULL;
+}
+
+/// Checks if `result` is the signal of a `recur`.
+static int builtin_is_recur(const lval* result)
+{
+    return result == &recur_signal && recur_args;
+}
+
+/// Interned names of the forms whose tail positions `recur` may appear in.
+static struct {
+    const char* recur;
+    const char* loop;
+    const char* eval;
+    const char* if_;
+    const char* do_;
+    const char* select;
+    const char* case_;
+} recur_forms = { NULL, NULL, NULL, NULL, NULL, NULL, NULL };
+
+static int builtin_recurs_in_tail(const lval* obj, int tail);
+
+/// Checks `builtin_recurs_in_tail` for the S-Expression `expr`, or a Q-Expression evaluated as one.
+static int builtin_recurs_in_tail_sexpr(const lval* expr, int tail)
+{
+    if (recur_forms.recur == NULL) {
+        recur_forms.recur = latom_intern("recur");
+        recur_forms.loop = latom_intern("loop");
+        recur_forms.eval = latom_intern("eval");
+        recur_forms.if_ = latom_intern("if");
+        recur_forms.do_ = latom_intern("do");
+        recur_forms.select = latom_intern("select");
+        recur_forms.case_ = latom_intern("case");
+    }
+
+    // `(x)` evaluates to whatever `x` does.
+    if (expr->count == 1) {
+        return builtin_recurs_in_tail(expr->cell[0], tail);
+    }
+
+    const char* head = expr->count && lval_type(expr->cell[0]) == LVAL_SYM ? expr->cell[0]->sym : NULL;
+    unsigned first = 0;
+
+    if (head == recur_forms.recur) {
+        if (!tail) {
+            return 0;
+        }
+
+        first = 1;
+    } else if (head == recur_forms.if_ && expr->count == 4
+        && lval_type(expr->cell[2]) == LVAL_QEXPR && lval_type(expr->cell[3]) == LVAL_QEXPR) {
+        return builtin_recurs_in_tail(expr->cell[1], 0)
+            && builtin_recurs_in_tail_sexpr(expr->cell[2], tail)
+            && builtin_recurs_in_tail_sexpr(expr->cell[3], tail);
+    } else if (head == recur_forms.do_) {
+        for (unsigned i = 1; i < expr->count; i++) {
+            if (!builtin_recurs_in_tail(expr->cell[i], tail && i + 1 == expr->count)) {
+                return 0;
+            }
+        }
+
+        return 1;
+    } else if ((head == recur_forms.select || head == recur_forms.case_) && expr->count > 1) {
+        // The key of a `case` is evaluated like a condition.
+        first = head == recur_forms.case_ ? 2 : 1;
+
+        if (first == 2 && !builtin_recurs_in_tail(expr->cell[1], 0)) {
+            return 0;
+        }
+
+        for (unsigned i = first; i < expr->count; i++) {
+            const lval* clause = expr->cell[i];
+
+            if (lval_type(clause) != LVAL_QEXPR || clause->count < 2) {
+                return builtin_recurs_in_tail(clause, 0);
+            }
+
+            if (!builtin_recurs_in_tail(clause->cell[0], 0) || !builtin_recurs_in_tail(clause->cell[1], tail)) {
+                return 0;
+            }
+        }
+
+        return 1;
+    } else if (head == recur_forms.eval && expr->count == 2 && lval_type(expr->cell[1]) == LVAL_QEXPR) {
+        return builtin_recurs_in_tail_sexpr(expr->cell[1], tail);
+    } else if (head == recur_forms.loop) {
+        // A nested loop's body recurs to that loop.
+        first = 1;
+    }
+
+    for (unsigned i = first; i < expr->count; i++) {
+        if (!builtin_recurs_in_tail(expr->cell[i], 0)) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/// Checks if `recur` is only ever called in tail position of the loop body `obj`, or of
+/// the expression `obj` in it if `tail` is unset. Q-Expressions are data unless a form
+/// is known to evaluate them.
+static int builtin_recurs_in_tail(const lval* obj, int tail)
+{
+    switch (lval_type(obj)) {
+    case LVAL_SYM:
+        return obj->sym != recur_forms.recur;
+
+    case LVAL_SEXPR:
+        return builtin_recurs_in_tail_sexpr(obj, tail);
+
+    default:
+        return 1;
+    }
+}
+
+/// Returns `expr`, unshared if `child` is not already its `i`th child, with `child` as that child.
+static lval* builtin_loop_replace(lval* expr, unsigned i, lval* child)
+{
+    if (child == expr->cell[i]) {
+        lval_del(child);
+        return expr;
+    }
+
+    expr = lval_unshare(expr);
+    lval_del(expr->cell[i]);
+    expr->cell[i] = child;
+    return expr;
+}
+
+/// Returns `expr` with its `i`th child replaced by the result of builtin_loop_mark on it.
+static lval* builtin_loop_mark_at(lval* expr, unsigned i);
+
+/// Points the `recur` calls in tail position of the loop body `expr`, or of an S-Expression
+/// in tail position of it, at `loop_recur`, taking ownership of `expr` and returning the
+/// result. Expressions are only copied where they change, as builtin_recurs_in_tail checked
+/// that `recur` appears nowhere else.
+static lval* builtin_loop_mark(lval* expr)
+{
+    const char* head = expr->count && lval_type(expr->cell[0]) == LVAL_SYM ? expr->cell[0]->sym : NULL;
+
+    if (expr->count == 1) {
+        return lval_type(expr->cell[0]) == LVAL_SEXPR ? builtin_loop_mark_at(expr, 0) : expr;
+    }
+
+    if (head == recur_forms.recur) {
+        expr = lval_unshare(expr);
+        lval_del(expr->cell[0]);
+        expr->cell[0] = lval_ref(&loop_recur);
+    } else if (head == recur_forms.if_ && expr->count == 4
+        && lval_type(expr->cell[2]) == LVAL_QEXPR && lval_type(expr->cell[3]) == LVAL_QEXPR) {
+        expr = builtin_loop_mark_at(builtin_loop_mark_at(expr, 2), 3);
+    } else if (head == recur_forms.do_ && lval_type(expr->cell[expr->count - 1]) == LVAL_SEXPR) {
+        expr = builtin_loop_mark_at(expr, expr->count - 1);
+    } else if ((head == recur_forms.select || head == recur_forms.case_) && expr->count > 1) {
+        for (unsigned i = head == recur_forms.case_ ? 2 : 1; i < expr->count; i++) {
+            lval* clause = expr->cell[i];
+
+            if (lval_type(clause) == LVAL_QEXPR && clause->count > 1 && lval_type(clause->cell[1]) == LVAL_SEXPR) {
+                expr = builtin_loop_replace(expr, i, builtin_loop_mark_at(lval_ref(clause), 1));
+            }
+        }
+    } else if (head == recur_forms.eval && expr->count == 2 && lval_type(expr->cell[1]) == LVAL_QEXPR) {
+        expr = builtin_loop_mark_at(expr, 1);
+    }
+
+    return expr;
+}
+
+static lval* builtin_loop_mark_at(lval* expr, unsigned i)
+{
+    return builtin_loop_replace(expr, i, builtin_loop_mark(lval_ref(expr->cell[i])));
+}
+
+/// Evaluates the Q-Expression `body` as an S-Expression in `env`, running `code` if it was compiled.
+static lval* builtin_loop_eval(lenv* env, lval* body, const lcode* code)
+{
+    return code ? lvm_run(env, code) : lval_eval_body(env, body);
+}
+
+/// Creates the frame of a loop, binding the symbols `syms` in order, as lval_resolve expects, to `vals`.
+static lenv* builtin_loop_scope(lenv* env, const lval* syms, lval* const* vals)
+{
+    lenv* scope = lenv_new();
+    scope->frame = 1;
+    scope->par = env;
+
+    for (unsigned i = 0; i < syms->count; i++) {
+        lenv_put(scope, syms->cell[i], vals[i]);
+    }
+
+    return scope;
+}
+
+/// Rebinds the symbols `syms` of the loop frame `scope` to `vals`.
+static void builtin_loop_rebind(lenv* scope, const lval* syms, lval* const* vals)
+{
+    // Distinct symbols were bound to one slot each, in
+    // order, so their values are replaced in place.
+    if (scope->count != syms->count) {
+        for (unsigned i = 0; i < syms->count; i++) {
+            lenv_put(scope, syms->cell[i], vals[i]);
+        }
+
+        return;
+    }
+
+    for (unsigned i = 0; i < syms->count; i++) {
+        lval* old = scope->vals[i];
+        scope->vals[i] = lval_ref(vals[i]);
+        lval_del(old);
+    }
+}
+
+lval* builtin_while(lenv* env, lval* arg)
+{
+    LASSERT_NUM("while", arg, 2)
+    LASSERT_TYPE("while", arg, 0, LVAL_QEXPR)
+    LASSERT_TYPE("while", arg, 1, LVAL_QEXPR)
+
+    lval* cond = arg->cell[0];
+    lval* body = arg->cell[1];
+    lcode* cond_code = builtin_loop_code(arg->cell[0]);
+    lcode* body_code = builtin_loop_code(arg->cell[1]);
+    lval* result = lval_qexpr();
+
+    while (lval_type(result) != LVAL_ERR) {
+        lval* test = builtin_loop_eval(env, cond, cond_code);
+
+        if (lval_type(test) == LVAL_NUM && lval_num_value(test) != 0) {
+            lval_del(test);
+            lval_del(result);
+            result = builtin_loop_eval(env, body, body_code);
+            continue;
+        }
+
+        if (lval_type(test) == LVAL_ERR) {
+            lval_del(result);
+            result = test;
+            break;
+        }
+
+        if (lval_type(test) != LVAL_NUM) {
+            lval_del(result);
+            result = lval_err("Function '%s' passed incorrect type for argument %i. "
+                              "Got %s, Expected %s.",
+                "while", 0, ltype_name(lval_type(test)), ltype_name(LVAL_NUM));
+        }
+
+        lval_del(test);
+        break;
+    }
+
+    if (cond_code) {
+        lvm_code_del(cond_code);
+        lvm_code_del(body_code);
+    }
+
+    lval_del(arg);
+    return result;
+}
+
+lval* builtin_loop(lenv* env, lval* arg)
+{
+    LASSERT(arg, arg->count > 1,
+        "Function '%s' passed incorrect number of arguments. "
+        "Got %i, Expected %i.",
+        "loop", arg->count, 2)
+    LASSERT_TYPE("loop", arg, 0, LVAL_QEXPR)
+    LASSERT_TYPE("loop", arg, arg->count - 1, LVAL_QEXPR)
+
+    const lval* syms = arg->cell[0];
+
+    for (unsigned i = 0; i < syms->count; ++i) {
+        LASSERT(arg, (lval_type(syms->cell[i]) == LVAL_SYM),
+            "Function '%s' cannot define non-symbol. "
+            "Got %s, Expected %s.",
+            "loop",
+            ltype_name(lval_type(syms->cell[i])),
+            ltype_name(LVAL_SYM))
+    }
+
+    LASSERT(arg, (syms->count == arg->count - 2),
+        "Function '%s' passed incorrect number of values for symbols. "
+        "Got %i, Expected %i.",
+        "loop", arg->count - 2, syms->count)
+
+    LASSERT(arg, builtin_recurs_in_tail_sexpr(arg->cell[arg->count - 1], 1),
+        "Function '%s' called outside of tail position of '%s'.",
+        "recur", "loop")
+
+    // Only the calls checked above can signal this loop,
+    // any other `recur` being an error when called.
+    lval* body = builtin_loop_mark(lval_ref(arg->cell[arg->count - 1]));
+    lenv* scope = builtin_loop_scope(env, syms, arg->cell + 1);
+    lval_resolve(syms, body);
+    lcode* code = builtin_loop_code(body);
+    lval* result = NULL;
+
+    loops++;
+
+    // Each `recur` in tail position ends an iteration,
+    // rebinding the loop variables in place for the next.
+    while (builtin_is_recur(result = builtin_loop_eval(scope, body, code))) {
+        lval* next = recur_args;
+        recur_args = NULL;
+
+        if (next->count != syms->count) {
+            lval_del(result);
+            result = lval_err("Function '%s' passed incorrect number of arguments. "
+                              "Got %i, Expected %i.",
+                "recur", next->count, syms->count);
+            lval_del(next);
+            break;
+        }
+
+        builtin_loop_rebind(scope, syms, next->cell);
+        lval_del(next);
+        lval_del(result);
+    }
+
+    loops--;
+
+    // Arguments of a `recur` whose signal was discarded
+    // must not outlive the loop, and the region if any.
+    if (recur_args) {
+        lval_del(recur_args);
+        recur_args = NULL;
+    }
+
+    if (code) {
+        lvm_code_del(code);
+    }
+
+    lenv_del(scope);
+    lval_del(body);
+    lval_del(arg);
+    return result;
+}
+
+/// Stores the arguments of a `recur` in tail position of a loop body and signals the loop.
+static lval* builtin_loop_recur(lenv* env, lval* arg)
+{
+    // A body returned as data may be evaluated later.
+    if (loops == 0) {
+        return builtin_recur(env, arg);
+    }
+
+    if (recur_args) {
+        lval_del(recur_args);
+    }
+
+    recur_args = arg;
+    return lval_ref(&recur_signal);
+}
+
+lval* builtin_recur(lenv* env, lval* arg)
+{
+    (void)env;
+    lval_del(arg);
+
+    if (loops == 0) {
+        return lval_err("Function 'recur' called outside of 'loop'");
+    }
+
+    return lval_err("Function '%s' called outside of tail position of '%s'.", "recur", "loop");
+}
+
+lval* builtin_for_range(lenv* env, lval* arg)
+{
+    LASSERT(arg, arg->count == 4 || arg->count == 5,
+        "Function '%s' passed incorrect number of arguments. "
+        "Got %i, Expected %i.",
+        "for-range", arg->count, 4)
+    LASSERT_TYPE("for-range", arg, 0, LVAL_QEXPR)
+    LASSERT(arg, arg->cell[0]->count == 1 && lval_type(arg->cell[0]->cell[0]) == LVAL_SYM,
+        "Function '%s' passed incorrect type for argument %i. "
+        "Got %s, Expected %s.",
+        "for-range", 0, ltype_name(LVAL_QEXPR), "Q-Expression of a single Symbol")
+
+    for (unsigned i = 1; i + 1 < arg->count; i++) {
+        LASSERT_TYPE("for-range", arg, i, LVAL_NUM)
+    }
+
+    LASSERT_TYPE("for-range", arg, arg->count - 1, LVAL_QEXPR)
+
+    long start = lval_num_value(arg->cell[1]); // NOLINT(google-runtime-int)
+    long end = lval_num_value(arg->cell[2]); // NOLINT(google-runtime-int)
+    long step = arg->count == 5 ? lval_num_value(arg->cell[3]) : 1; // NOLINT(google-runtime-int)
+
+    LASSERT(arg, step != 0, "Function '%s' passed a step of zero.", "for-range")
+
+    lval* body = arg->cell[arg->count - 1];
+    lenv* scope = builtin_loop_scope(env, arg->cell[0], arg->cell + 1);
+    lval_resolve(arg->cell[0], body);
+    lcode* code = builtin_loop_code(body);
+    lval* result = lval_qexpr();
+
+    // The iterations are counted up front in unsigned
+    // arithmetic, so bounds near the limits cannot overflow.
+    unsigned long stride = step > 0 ? (unsigned long)step : 0UL - (unsigned long)step; // NOLINT(google-runtime-int)
+    unsigned long span = step > 0 ? (unsigned long)end - (unsigned long)start : (unsigned long)start - (unsigned long)end; // NOLINT(google-runtime-int)
+    unsigned long steps = (step > 0 ? start < end : start > end) ? (span - 1) / stride + 1 : 0; // NOLINT(google-runtime-int)
+
+    for (unsigned long n = 0; n < steps && lval_type(result) != LVAL_ERR; n++) { // NOLINT(google-runtime-int)
+        lval* index = lval_num((long)((unsigned long)start + n * (unsigned long)step)); // NOLINT(google-runtime-int)
+        builtin_loop_rebind(scope, arg->cell[0], &index);
+        lval_del(index);
+
+        lval_del(result);
+        result = builtin_loop_eval(scope, body, code);
+    }
+
+    if (code) {
+        lvm_code_del(code);
+    }
+
+    lenv_del(scope);
+    lval_del(arg);
+    return result;
+}
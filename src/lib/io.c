@@ -10,9 +10,9 @@
 
 void lval_print(const lval* obj)
 {
-    switch (obj->type) {
+    switch (lval_type(obj)) {
     case LVAL_NUM:
-        printf("%li", obj->num);
+        printf("%li", lval_num_value(obj));
         break;
 
     case LVAL_ERR:
@@ -31,9 +31,20 @@ void lval_print(const lval* obj)
         if (obj->builtin) {
             printf("<builtin>");
         } else {
-            printf("(\\ ");
-            lval_print(obj->formals);
-            putchar(' ');
+            // A partial application shows the formals it has left.
+            unsigned bound = obj->bound ? obj->bound->count : 0;
+
+            printf("(\\ {");
+
+            for (unsigned i = bound; i < obj->formals->count; i++) {
+                lval_print(obj->formals->cell[i]);
+
+                if (i != obj->formals->count - 1) {
+                    putchar(' ');
+                }
+            }
+
+            printf("} ");
             lval_print(obj->body);
             putchar(')');
         }
@@ -0,0 +1,641 @@
+#include <lalloc.h>
+#include <lenv.h>
+#include <lval.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// Objects are carved out of slabs of this many bytes.
+#define LALLOC_SLAB_SIZE 65536
+
+/// Cell arrays longer than this are not pooled.
+#define LALLOC_MAX_POOLED_CELLS (1U << (LALLOC_CELL_CLASSES - 1))
+
+/// Bytes a region may bump before it overflows into the pools.
+#define LALLOC_REGION_LIMIT 67108864
+
+static size_t large_bytes = 0;
+
+/// Returns the memory `ptr` obtained from the system, exiting if there was none.
+static void* lalloc_checked(void* ptr)
+{
+    if (!ptr) {
+        exit(1); // NOLINT(concurrency-mt-unsafe)
+    }
+
+    return ptr;
+}
+
+#ifndef LISPY_SYSTEM_ALLOC
+
+////////////////////////
+// Pools
+////////////////////////
+
+/// @brief Header of a slab page.
+///
+/// @details Unioned with max_align_t so the objects
+/// following it are suitably aligned.
+typedef union lslab {
+    union lslab* next;
+    max_align_t align;
+} lslab;
+
+/// @brief Node of a free list, stored in the freed object.
+///
+/// @details Pools of lvals and lenvs store the node
+/// `link` bytes into the object so its leading `flags`
+/// byte can be set to LALLOC_FREE.
+typedef struct lfree {
+    struct lfree* next;
+} lfree;
+
+/// @brief A pool of fixed size objects.
+///
+/// A `lpool` consists of a:
+/// - size      : size_t corresponding to the size of each object
+/// - link      : size_t corresponding to the offset of the lfree node in a released object
+/// - slabs     : lslab* corresponding to the list of slabs owned by the pool
+/// - bump      : char* corresponding to the next uncarved byte of the newest slab
+/// - end       : char* corresponding to the end of the newest slab
+/// - free      : lfree* corresponding to the list of released objects
+/// - nfree     : size_t corresponding to the length of `free`
+/// - nslabs    : size_t corresponding to the length of `slabs`
+/// - live      : size_t corresponding to the number of objects handed out
+typedef struct lpool {
+    size_t size;
+    size_t link;
+    lslab* slabs;
+    char* bump;
+    char* end;
+    lfree* free;
+    size_t nfree;
+    size_t nslabs;
+    size_t live;
+} lpool;
+
+#define LALLOC_POOL(type) { sizeof(type), sizeof(void*), NULL, NULL, NULL, NULL, 0, 0, 0 }
+#define LALLOC_CELL_POOL(nth) { sizeof(void*) << (nth), 0, NULL, NULL, NULL, NULL, 0, 0, 0 }
+
+static lpool lval_pool = LALLOC_POOL(lval);
+static lpool lenv_pool = LALLOC_POOL(lenv);
+
+static lpool cell_pools[LALLOC_CELL_CLASSES] = {
+    LALLOC_CELL_POOL(0),
+    LALLOC_CELL_POOL(1),
+    LALLOC_CELL_POOL(2),
+    LALLOC_CELL_POOL(3),
+    LALLOC_CELL_POOL(4),
+    LALLOC_CELL_POOL(5),
+    LALLOC_CELL_POOL(6),
+};
+
+static void* lpool_alloc(lpool* pool)
+{
+    pool->live++;
+
+    if (pool->free) {
+        lfree* node = pool->free;
+        pool->free = node->next;
+        pool->nfree--;
+        return (char*)node - pool->link;
+    }
+
+    if (pool->bump == NULL || (size_t)(pool->end - pool->bump) < pool->size) {
+        lslab* slab = malloc(LALLOC_SLAB_SIZE);
+
+        if (!slab) {
+            exit(1); // NOLINT(concurrency-mt-unsafe)
+        }
+
+        slab->next = pool->slabs;
+        pool->slabs = slab;
+        pool->nslabs++;
+
+        pool->bump = (char*)(slab + 1);
+        pool->end = (char*)slab + LALLOC_SLAB_SIZE;
+    }
+
+    void* obj = pool->bump;
+    pool->bump += pool->size;
+    return obj;
+}
+
+static void lpool_free(lpool* pool, void* obj)
+{
+    if (pool->link) {
+        *(unsigned char*)obj = LALLOC_FREE;
+    }
+
+    lfree* node = (lfree*)((char*)obj + pool->link);
+    node->next = pool->free;
+    pool->free = node;
+    pool->nfree++;
+    pool->live--;
+}
+
+/// Returns the size class holding `count` pointers or -1 if unpooled.
+static int cell_class(unsigned count)
+{
+    if (count > LALLOC_MAX_POOLED_CELLS) {
+        return -1;
+    }
+
+    int nth = 0;
+
+    while ((1U << nth) < count) {
+        nth++;
+    }
+
+    return nth;
+}
+
+////////////////////////
+// Region
+////////////////////////
+
+/// @brief A slot holding one region lval or lenv.
+typedef union lslot {
+    lval obj;
+    lenv env;
+} lslot;
+
+/// @brief The bump region.
+///
+/// @details The region is a single block of LALLOC_REGION_LIMIT
+/// bytes reserved on first use and kept for the rest of the
+/// session, so ownership of a pointer is a range check. Pages
+/// are only touched as the bump pointers reach them.
+///
+/// Cell arrays and strings are bumped up from the start of the
+/// block while lvals and lenvs are bumped down from its end in
+/// slots of the same size, so the objects of the region can be
+/// walked when it ends.
+///
+/// A `lregion` consists of a:
+/// - base      : char* corresponding to the start of the block
+/// - bump      : char* corresponding to the next free byte
+/// - top       : char* corresponding to the last slot handed out
+/// - end       : char* corresponding to the end of the block
+/// - enabled   : int set when region mode is on
+/// - depth     : unsigned corresponding to the nesting of lalloc_region_begin
+/// - heap      : unsigned corresponding to the nesting of lalloc_heap_begin
+/// - overflowed: int set once an allocation did not fit in the block
+typedef struct lregion {
+    char* base;
+    char* bump;
+    char* top;
+    char* end;
+    int enabled;
+    unsigned depth;
+    unsigned heap;
+    int overflowed;
+} lregion;
+
+static lregion region = { NULL, NULL, NULL, NULL, 0, 0, 0, 0 };
+
+int lalloc_region_active(void)
+{
+    return region.depth > 0 && region.heap == 0 && !region.overflowed;
+}
+
+int lalloc_region_overflowed(void)
+{
+    return region.overflowed;
+}
+
+/// Returns NULL and marks the region overflowed when `size`
+/// bytes no longer fit.
+static void* region_alloc(size_t size)
+{
+    size = (size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+
+    if ((size_t)(region.top - region.bump) < size) {
+        region.overflowed = 1;
+        return NULL;
+    }
+
+    void* obj = region.bump;
+    region.bump += size;
+    return obj;
+}
+
+/// Returns NULL and marks the region overflowed when no
+/// lslot fits any more.
+static void* region_slot(void)
+{
+    if ((size_t)(region.top - region.bump) < sizeof(lslot)) {
+        region.overflowed = 1;
+        return NULL;
+    }
+
+    region.top -= sizeof(lslot);
+    return region.top;
+}
+
+static int region_owns(const void* ptr)
+{
+    return (uintptr_t)ptr >= (uintptr_t)region.base
+        && (uintptr_t)ptr < (uintptr_t)region.end;
+}
+
+/// Returns the capacity reserved for `count` cells in the region.
+static unsigned region_cell_capacity(unsigned count)
+{
+    int nth = cell_class(count);
+    return nth >= 0 ? (1U << nth) : count;
+}
+
+void lalloc_set_region_mode(int enabled)
+{
+    region.enabled = enabled;
+}
+
+void lalloc_region_begin(void)
+{
+    if (!region.enabled) {
+        return;
+    }
+
+    if (region.base == NULL) {
+        region.base = malloc(LALLOC_REGION_LIMIT);
+
+        if (!region.base) {
+            exit(1); // NOLINT(concurrency-mt-unsafe)
+        }
+
+        region.bump = region.base;
+        region.end = region.base + LALLOC_REGION_LIMIT;
+        region.top = region.end;
+    }
+
+    region.depth++;
+}
+
+void lalloc_region_end(void)
+{
+    if (region.depth == 0 || --region.depth > 0) {
+        return;
+    }
+
+    // The objects left in the region give back what they
+    // borrowed from the heap. Clearing the overflow first
+    // keeps them from releasing each other.
+    region.overflowed = 0;
+
+    for (char* slot = region.top; slot < region.end; slot += sizeof(lslot)) {
+        unsigned char flags = *(unsigned char*)slot;
+
+        if (flags & LALLOC_FREE) {
+            continue;
+        }
+
+        if (flags & LALLOC_LENV) {
+            lenv_del((lenv*)slot);
+        } else {
+            lval_release((lval*)slot);
+        }
+    }
+
+    region.bump = region.base;
+    region.top = region.end;
+}
+
+void lalloc_heap_begin(void)
+{
+    region.heap++;
+}
+
+void lalloc_heap_end(void)
+{
+    region.heap--;
+}
+
+////////////////////////
+// `lval` Allocation
+////////////////////////
+
+lval* lalloc_lval(void)
+{
+    lval* obj = lalloc_region_active() ? region_slot() : NULL;
+
+    if (obj) {
+        obj->flags = LALLOC_REGION;
+    } else {
+        obj = lpool_alloc(&lval_pool);
+        obj->flags = 0;
+    }
+
+    return obj;
+}
+
+void lalloc_lval_free(lval* obj)
+{
+    if (obj->flags & LALLOC_REGION) {
+        obj->flags |= LALLOC_FREE;
+        return;
+    }
+
+    lpool_free(&lval_pool, obj);
+}
+
+////////////////////////
+// `lenv` Allocation
+////////////////////////
+
+lenv* lalloc_lenv(void)
+{
+    lenv* env = lalloc_region_active() ? region_slot() : NULL;
+
+    if (env) {
+        env->flags = LALLOC_REGION | LALLOC_LENV;
+    } else {
+        env = lpool_alloc(&lenv_pool);
+        env->flags = 0;
+    }
+
+    return env;
+}
+
+void lalloc_lenv_free(lenv* env)
+{
+    if (env->flags & LALLOC_REGION) {
+        env->flags |= LALLOC_FREE;
+        return;
+    }
+
+    lpool_free(&lenv_pool, env);
+}
+
+///////////////////////////
+// Cell Array Allocation
+///////////////////////////
+
+static void* heap_cells(unsigned count)
+{
+    int nth = cell_class(count);
+
+    if (nth >= 0) {
+        return lpool_alloc(&cell_pools[nth]);
+    }
+
+    large_bytes += sizeof(void*) * count;
+    return lalloc_checked(malloc(sizeof(void*) * count));
+}
+
+void* lalloc_cells(unsigned count)
+{
+    if (count == 0) {
+        return NULL;
+    }
+
+    void* cells = lalloc_region_active()
+        ? region_alloc(sizeof(void*) * region_cell_capacity(count))
+        : NULL;
+
+    return cells ? cells : heap_cells(count);
+}
+
+void* lalloc_cells_resize(void* cells, unsigned old_count, unsigned new_count)
+{
+    if (cells == NULL) {
+        return lalloc_cells(new_count);
+    }
+
+    if (new_count == 0) {
+        lalloc_cells_free(cells, old_count);
+        return NULL;
+    }
+
+    if (region_owns(cells)) {
+        if (region_cell_capacity(old_count) >= new_count) {
+            return cells;
+        }
+
+        // Once the region has overflowed, growing arrays move to the heap.
+        void* ncells = lalloc_region_active()
+            ? region_alloc(sizeof(void*) * region_cell_capacity(new_count))
+            : NULL;
+
+        if (ncells == NULL) {
+            ncells = heap_cells(new_count);
+        }
+
+        memcpy(ncells, cells, sizeof(void*) * old_count); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+        return ncells;
+    }
+
+    int old_nth = cell_class(old_count);
+    int new_nth = cell_class(new_count);
+
+    if (old_nth >= 0 && old_nth == new_nth) {
+        return cells;
+    }
+
+    if (old_nth < 0 && new_nth < 0) {
+        large_bytes -= sizeof(void*) * old_count;
+        large_bytes += sizeof(void*) * new_count;
+        return lalloc_checked(realloc(cells, sizeof(void*) * new_count));
+    }
+
+    void* ncells = heap_cells(new_count);
+    memcpy(ncells, cells, sizeof(void*) * (old_count < new_count ? old_count : new_count)); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+    lalloc_cells_free(cells, old_count);
+    return ncells;
+}
+
+void lalloc_cells_free(void* cells, unsigned count)
+{
+    if (cells == NULL || region_owns(cells)) {
+        return;
+    }
+
+    int nth = cell_class(count);
+
+    if (nth >= 0) {
+        lpool_free(&cell_pools[nth], cells);
+        return;
+    }
+
+    large_bytes -= sizeof(void*) * count;
+    free(cells);
+}
+
+////////////////////////
+// String Allocation
+////////////////////////
+
+char* lalloc_chars(size_t size)
+{
+    char* str = lalloc_region_active() ? region_alloc(size) : NULL;
+    return str ? str : lalloc_checked(malloc(size));
+}
+
+void lalloc_chars_free(char* str)
+{
+    if (!region_owns(str)) {
+        free(str);
+    }
+}
+
+//////////////////////
+// Statistics
+//////////////////////
+
+lalloc_stats lalloc_get_stats(void)
+{
+    lalloc_stats stats;
+    memset(&stats, 0, sizeof(stats)); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+
+    stats.region_bytes = (size_t)(region.bump - region.base) + (size_t)(region.end - region.top);
+    stats.bytes_in_use = large_bytes
+        + lval_pool.live * lval_pool.size
+        + lenv_pool.live * lenv_pool.size;
+    stats.slabs = lval_pool.nslabs + lenv_pool.nslabs;
+    stats.live_lvals = lval_pool.live;
+    stats.free_lvals = lval_pool.nfree;
+    stats.free_lenvs = lenv_pool.nfree;
+
+    for (int i = 0; i < LALLOC_CELL_CLASSES; i++) {
+        stats.bytes_in_use += cell_pools[i].live * cell_pools[i].size;
+        stats.slabs += cell_pools[i].nslabs;
+        stats.free_cells[i] = cell_pools[i].nfree;
+    }
+
+    return stats;
+}
+
+#else /// LISPY_SYSTEM_ALLOC
+
+static size_t small_bytes = 0;
+
+////////////////////////
+// `lval` Allocation
+////////////////////////
+
+lval* lalloc_lval(void)
+{
+    small_bytes += sizeof(lval);
+    lval* obj = lalloc_checked(malloc(sizeof(lval)));
+    obj->flags = 0;
+    return obj;
+}
+
+void lalloc_lval_free(lval* obj)
+{
+    small_bytes -= sizeof(lval);
+    free(obj);
+}
+
+////////////////////////
+// `lenv` Allocation
+////////////////////////
+
+lenv* lalloc_lenv(void)
+{
+    small_bytes += sizeof(lenv);
+    lenv* env = lalloc_checked(malloc(sizeof(lenv)));
+    env->flags = 0;
+    return env;
+}
+
+void lalloc_lenv_free(lenv* env)
+{
+    small_bytes -= sizeof(lenv);
+    free(env);
+}
+
+///////////////////////////
+// Cell Array Allocation
+///////////////////////////
+
+void* lalloc_cells(unsigned count)
+{
+    if (count == 0) {
+        return NULL;
+    }
+
+    large_bytes += sizeof(void*) * count;
+    return lalloc_checked(malloc(sizeof(void*) * count));
+}
+
+void* lalloc_cells_resize(void* cells, unsigned old_count, unsigned new_count)
+{
+    if (new_count == 0) {
+        lalloc_cells_free(cells, old_count);
+        return NULL;
+    }
+
+    if (cells) {
+        large_bytes -= sizeof(void*) * old_count;
+    }
+
+    large_bytes += sizeof(void*) * new_count;
+    return lalloc_checked(realloc(cells, sizeof(void*) * new_count));
+}
+
+void lalloc_cells_free(void* cells, unsigned count)
+{
+    if (cells == NULL) {
+        return;
+    }
+
+    large_bytes -= sizeof(void*) * count;
+    free(cells);
+}
+
+////////////////////////
+// String Allocation
+////////////////////////
+
+char* lalloc_chars(size_t size)
+{
+    return lalloc_checked(malloc(size));
+}
+
+void lalloc_chars_free(char* str)
+{
+    free(str);
+}
+
+//////////////////////
+// Regions
+//////////////////////
+
+void lalloc_set_region_mode(int enabled)
+{
+    (void)enabled;
+}
+
+int lalloc_region_active(void)
+{
+    return 0;
+}
+
+int lalloc_region_overflowed(void)
+{
+    return 0;
+}
+
+void lalloc_region_begin(void) { }
+
+void lalloc_region_end(void) { }
+
+void lalloc_heap_begin(void) { }
+
+void lalloc_heap_end(void) { }
+
+//////////////////////
+// Statistics
+//////////////////////
+
+lalloc_stats lalloc_get_stats(void)
+{
+    lalloc_stats stats;
+    memset(&stats, 0, sizeof(stats)); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+    stats.bytes_in_use = small_bytes + large_bytes;
+    return stats;
+}
+
+#endif /// LISPY_SYSTEM_ALLOC
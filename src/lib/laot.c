@@ -0,0 +1,269 @@
+#include <laot.h>
+
+#include <builtin.h>
+#include <io.h>
+#include <lalloc.h>
+#include <lenv.h>
+#include <lval.h>
+#include <lvm.h>
+#include <utilities.h>
+
+#include <stdint.h>
+#include <string.h>
+
+//////////////////////
+// Construction
+//////////////////////
+
+void laot_build(lval** nodes, const laot_node* table, const unsigned* children, unsigned count)
+{
+    for (unsigned i = 0; i < count; i++) {
+        const laot_node* node = &table[i];
+
+        switch (node->type) {
+        case LVAL_NUM:
+            nodes[i] = lval_num(node->num);
+            break;
+
+        case LVAL_SYM:
+            nodes[i] = lval_sym(node->text);
+            break;
+
+        case LVAL_STR:
+            nodes[i] = lval_str(node->text);
+            break;
+
+        case LVAL_ERR:
+            nodes[i] = lval_err("%s", node->text);
+            break;
+
+        default:
+            nodes[i] = node->type == LVAL_SEXPR ? lval_sexpr() : lval_qexpr();
+
+            for (unsigned j = 0; j < node->count; j++) {
+                lval_add(nodes[i], nodes[children[node->first + j]]);
+            }
+            break;
+        }
+    }
+
+    for (unsigned i = 0; i < count; i++) {
+        if (table[i].kept) {
+            lval_ref(nodes[i]);
+        }
+    }
+}
+
+void laot_release(lval** nodes, const laot_node* table, unsigned count)
+{
+    for (unsigned i = 0; i < count; i++) {
+        if (table[i].kept) {
+            lval_del(nodes[i]);
+        }
+    }
+}
+
+//////////////////////
+// Evaluation
+//////////////////////
+
+void laot_eval(lenv* env, lval* expr)
+{
+    lalloc_region_begin();
+
+    lval* result = lval_eval(env, expr);
+
+    if (lval_type(result) == LVAL_ERR) {
+        lval_println(result);
+    }
+
+    lval_del(result);
+    lalloc_region_end();
+}
+
+/// Checks that none of `formals` is '&'.
+static int laot_plain_formals(const lval* formals)
+{
+    for (unsigned i = 0; i < formals->count; i++) {
+        if (strcmp(formals->cell[i]->sym, "&") == 0) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+void laot_attach(lenv* env, lval* sym, lval* source, lnative func)
+{
+    lval* value = lenv_get(env, sym);
+
+    if (lval_type(value) == LVAL_FUN && !value->builtin && value->code
+        && lval_eq(value->body, source) && laot_plain_formals(value->formals)) {
+        lvm_attach(value->code, func);
+    }
+
+    lval_del(value);
+}
+
+//////////////////////
+// Calls
+//////////////////////
+
+/// Number of compiled bodies running and the native stack
+/// address the outermost of them was entered at.
+static unsigned nesting = 0;
+static uintptr_t nesting_base = 0;
+
+int laot_begin(void)
+{
+    char marker = 0;
+    uintptr_t here = (uintptr_t)&marker;
+
+    if (nesting == 0) {
+        nesting_base = here;
+    }
+
+    uintptr_t used = nesting_base > here ? nesting_base - here : here - nesting_base;
+
+    if (used > LAOT_STACK_BYTES) {
+        return 0;
+    }
+
+    lval* err = lval_enter(1);
+
+    if (err) {
+        lval_del(err);
+        return 0;
+    }
+
+    nesting++;
+    return 1;
+}
+
+void laot_end(void)
+{
+    nesting--;
+    lval_leave();
+}
+
+int laot_is(const lval* obj, lbuiltin func)
+{
+    return lval_type(obj) == LVAL_FUN && obj->builtin == func;
+}
+
+int laot_is_special(const lval* obj)
+{
+    return lval_type(obj) == LVAL_FUN && obj->builtin && builtin_special(obj->builtin);
+}
+
+lval* laot_apply2(lenv* env, lval* head, lval* lhs, lval* rhs)
+{
+    if (lval_type(head) == LVAL_FUN && head->builtin
+        && lval_type(lhs) == LVAL_NUM && lval_type(rhs) == LVAL_NUM) {
+        long lnum = lval_num_value(lhs); // NOLINT(google-runtime-int)
+        long rnum = lval_num_value(rhs); // NOLINT(google-runtime-int)
+        lbuiltin func = head->builtin;
+        lval* result = NULL;
+
+        if (func == builtin_add) {
+            result = lval_num(lnum + rnum);
+        } else if (func == builtin_sub) {
+            result = lval_num(lnum - rnum);
+        } else if (func == builtin_mul) {
+            result = lval_num(lnum * rnum);
+        } else if (func == builtin_div && rnum != 0) {
+            result = lval_num(lnum / rnum);
+        } else if (func == builtin_eq) {
+            result = lval_num(lnum == rnum);
+        } else if (func == builtin_ne) {
+            result = lval_num(lnum != rnum);
+        } else if (func == builtin_lt) {
+            result = lval_num(lnum < rnum);
+        } else if (func == builtin_gt) {
+            result = lval_num(lnum > rnum);
+        } else if (func == builtin_le) {
+            result = lval_num(lnum <= rnum);
+        } else if (func == builtin_ge) {
+            result = lval_num(lnum >= rnum);
+        }
+
+        if (result) {
+            lval_del(head);
+            lval_del(lhs);
+            lval_del(rhs);
+            return result;
+        }
+    }
+
+    lval* sexpr = lval_add(lval_sexpr(), head);
+    lval_add(sexpr, lhs);
+    lval_add(sexpr, rhs);
+    return lval_apply(env, sexpr);
+}
+
+int laot_test(lval** cond)
+{
+    if (lval_type(*cond) == LVAL_NUM) {
+        int truth = lval_num_value(*cond) != 0;
+        lval_del(*cond);
+        return truth;
+    }
+
+    if (lval_type(*cond) != LVAL_ERR) {
+        lval* err = lval_err("Function '%s' passed incorrect type for argument %i. "
+                             "Got %s, Expected %s.",
+            "if", 0, ltype_name(lval_type(*cond)), ltype_name(LVAL_NUM));
+
+        lval_del(*cond);
+        *cond = err;
+    }
+
+    return -1;
+}
+
+lenv* laot_enter(lenv* env, lval* sexpr, lnative func)
+{
+    const lval* head = sexpr->cell[0];
+
+    // Only the lambda `func` was compiled from and its
+    // copies share the code it is attached to, so their
+    // formals are the plain ones lispyc counted the
+    // arguments against.
+    if (lval_type(head) != LVAL_FUN || head->builtin || head->bound
+        || !head->code || lvm_attached(head->code) != func) {
+        return NULL;
+    }
+
+    // Native code is faster still, so once the callee has
+    // it the call is made by lval_apply, which runs it.
+    if (lvm_count_call(head)) {
+        return NULL;
+    }
+
+    for (unsigned i = 1; i < sexpr->count; i++) {
+        if (lval_type(sexpr->cell[i]) == LVAL_ERR) {
+            return NULL;
+        }
+    }
+
+    if (!laot_begin()) {
+        return NULL;
+    }
+
+    lenv* frame = lenv_new();
+    frame->frame = 1;
+    frame->par = env;
+
+    for (unsigned i = 1; i < sexpr->count; i++) {
+        lenv_put(frame, head->formals->cell[i - 1], sexpr->cell[i]);
+    }
+
+    lval_del(sexpr);
+    return frame;
+}
+
+void laot_leave(lenv* frame)
+{
+    lenv_del(frame);
+    laot_end();
+}
@@ -0,0 +1,113 @@
+#include <latom.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+/// Initial number of slots in the intern table.
+#define LATOM_MIN_SLOTS 256
+
+/// @brief The intern table.
+///
+/// A `ltable` consists of a:
+/// - slots     : latom** corresponding to an open addressed array of atoms
+/// - capacity  : size_t corresponding to the length of `slots`, a power of two
+/// - count     : size_t corresponding to the number of atoms interned
+typedef struct ltable {
+    latom** slots;
+    size_t capacity;
+    size_t count;
+} ltable;
+
+static ltable table = { NULL, 0, 0 };
+
+/// FNV-1a over the first `len` characters of `name`.
+static unsigned latom_hash(const char* name, size_t len)
+{
+    unsigned hash = 2166136261U;
+
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
+static const char* latom_name(const latom* atom)
+{
+    return (const char*)(atom + 1);
+}
+
+static void latom_grow(void)
+{
+    size_t capacity = table.capacity ? table.capacity * 2 : LATOM_MIN_SLOTS;
+    latom** slots = calloc(capacity, sizeof(latom*));
+
+    if (!slots) {
+        exit(1); // NOLINT(concurrency-mt-unsafe)
+    }
+
+    for (size_t i = 0; i < table.capacity; i++) {
+        if (table.slots[i]) {
+            size_t idx = table.slots[i]->hash & (capacity - 1);
+
+            while (slots[idx]) {
+                idx = (idx + 1) & (capacity - 1);
+            }
+
+            slots[idx] = table.slots[i];
+        }
+    }
+
+    free(table.slots);
+    table.slots = slots;
+    table.capacity = capacity;
+}
+
+const char* latom_intern(const char* name)
+{
+    return latom_intern_n(name, strlen(name));
+}
+
+const char* latom_intern_n(const char* name, size_t len)
+{
+    if (2 * (table.count + 1) > table.capacity) {
+        latom_grow();
+    }
+
+    unsigned hash = latom_hash(name, len);
+    size_t idx = hash & (table.capacity - 1);
+
+    for (; table.slots[idx]; idx = (idx + 1) & (table.capacity - 1)) {
+        const latom* atom = table.slots[idx];
+        const char* aname = latom_name(atom);
+
+        if (atom->hash == hash && strncmp(aname, name, len) == 0 && aname[len] == '\0') {
+            return aname;
+        }
+    }
+
+    latom* atom = malloc(sizeof(latom) + len + 1);
+
+    if (!atom) {
+        exit(1); // NOLINT(concurrency-mt-unsafe)
+    }
+
+    atom->id = (unsigned)table.count;
+    atom->hash = hash;
+    atom->frames = 0;
+
+    char* aname = (char*)(atom + 1);
+    memcpy(aname, name, len); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+    aname[len] = '\0';
+
+    table.slots[idx] = atom;
+    table.count++;
+
+    return aname;
+}
+
+size_t latom_count(void)
+{
+    return table.count;
+}
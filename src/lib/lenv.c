@@ -1,23 +1,36 @@
 #include <builtin.h>
+#include <lalloc.h>
+#include <latom.h>
 #include <lenv.h>
 #include <lval.h>
 
 #include <stdlib.h>
 #include <string.h>
 
+/// Bumped whenever a global binding is added, replaced or removed.
+static unsigned lenv_version = 1;
+
+static lenv_cache_stats cache_stats = { 0, 0, 0 };
+
+/// Whether lenv_add_builtins registers the native prelude functions.
+static int native_prelude = 1;
+
 ///////////////////////////
 // `lenv` Constructors
 ///////////////////////////
 
 lenv* lenv_new(void)
 {
-    lenv* env = malloc(sizeof(lenv));
+    lenv* env = lalloc_lenv();
 
     env->par = NULL;
+    env->frame = 0;
 
     env->count = 0;
+    env->capacity = 0;
     env->syms = NULL;
     env->vals = NULL;
+    env->index = NULL;
 
     return env;
 }
@@ -26,71 +39,216 @@ lenv* lenv_new(void)
 // `lenv` Destructors
 //////////////////////////
 
+/// Returns the number of cells backing the index of a `capacity` slot lenv.
+static unsigned lenv_index_cells(unsigned capacity)
+{
+    return (unsigned)((2 * capacity * sizeof(unsigned) + sizeof(void*) - 1) / sizeof(void*));
+}
+
 void lenv_del(lenv* env)
 {
     for (unsigned i = 0; i < env->count; i++) {
-        free(env->syms[i]);
         lval_del(env->vals[i]);
+
+        if (env->frame) {
+            latom_of(env->syms[i])->frames--;
+        }
+    }
+
+    if (!env->frame && env->count) {
+        lenv_version++;
     }
 
     env->par = NULL;
 
-    free(env->syms);
-    free(env->vals);
-    free(env);
+    lalloc_cells_free(env->syms, env->capacity);
+    lalloc_cells_free(env->vals, env->capacity);
+
+    if (env->index) {
+        lalloc_cells_free(env->index, lenv_index_cells(env->capacity));
+    }
+
+    lalloc_lenv_free(env);
 }
 
 //////////////////////
 // `lenv` Methods
 //////////////////////
 
-lval* lenv_get(lenv* env, const lval* key)
+/// Returns the position of the binding for `sym` or `env->count` if unbound.
+static unsigned lenv_find(const lenv* env, const char* sym)
 {
-    for (unsigned i = 0; i < env->count; i++) {
-        if (strcmp(env->syms[i], key->sym) == 0) {
-            return lval_copy(env->vals[i]);
+    if (env->index) {
+        unsigned mask = 2 * env->capacity - 1;
+
+        for (unsigned idx = latom_of(sym)->hash & mask; env->index[idx]; idx = (idx + 1) & mask) {
+            if (env->syms[env->index[idx] - 1] == sym) {
+                return env->index[idx] - 1;
+            }
         }
+
+        return env->count;
     }
 
-    if (env->par) {
-        return lenv_get(env->par, key);
+    unsigned i = 0;
+
+    while (i < env->count && env->syms[i] != sym) {
+        i++;
+    }
+
+    return i;
+}
+
+/// Records the binding at position `ith` in the index of `env`.
+static void lenv_index(lenv* env, unsigned ith)
+{
+    unsigned mask = 2 * env->capacity - 1;
+    unsigned idx = latom_of(env->syms[ith])->hash & mask;
+
+    while (env->index[idx]) {
+        idx = (idx + 1) & mask;
+    }
+
+    env->index[idx] = ith + 1;
+}
+
+/// Doubles the capacity of `env`, rebuilding its index if it has one.
+static void lenv_grow(lenv* env)
+{
+    unsigned capacity = env->capacity ? 2 * env->capacity : 4;
+
+    env->syms = lalloc_cells_resize(env->syms, env->capacity, capacity);
+    env->vals = lalloc_cells_resize(env->vals, env->capacity, capacity);
+
+    if (env->index) {
+        lalloc_cells_free(env->index, lenv_index_cells(env->capacity));
+        env->index = NULL;
+    }
+
+    env->capacity = capacity;
+
+    if (capacity >= LENV_INDEX_MIN) {
+        env->index = lalloc_cells(lenv_index_cells(capacity));
+        memset(env->index, 0, sizeof(unsigned) * 2 * capacity); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+
+        for (unsigned i = 0; i < env->count; i++) {
+            lenv_index(env, i);
+        }
+    }
+}
+
+lval* lenv_get(lenv* env, lval* key)
+{
+    const latom* atom = latom_of(key->sym);
+
+    // With no frame binding the name, every lookup ends at
+    // the global binding cached by this symbol, which is
+    // still current if no global binding changed since.
+    if (atom->frames == 0 && key->version == lenv_version && key->cached) {
+        cache_stats.cache_hits++;
+        return lval_ref(key->cached);
+    }
+
+    for (; env; env = env->par) {
+        // Every nearer environment has been searched, so a
+        // binding at the resolved slot is the innermost one.
+        if (key->slot < env->count && env->syms[key->slot] == key->sym) {
+            cache_stats.slot_hits++;
+            return lval_ref(env->vals[key->slot]);
+        }
+
+        unsigned ith = lenv_find(env, key->sym);
+
+        if (ith < env->count) {
+            cache_stats.misses++;
+
+            if (!env->frame && atom->frames == 0) {
+                key->version = lenv_version;
+                key->cached = env->vals[ith];
+            }
+
+            return lval_ref(env->vals[ith]);
+        }
     }
 
+    cache_stats.misses++;
+
     return lval_err("Unbound symbol '%s'", key->sym);
 }
 
-void lenv_put(lenv* env, const lval* key, lval* value)
+static void lenv_set(lenv* env, const lval* key, lval* value)
 {
-    for (unsigned i = 0; i < env->count; i++) {
-        if (strcmp(env->syms[i], key->sym) == 0) {
-            lval_del(env->vals[i]);
-            env->vals[i] = lval_copy(value);
-            return;
+    unsigned ith = lenv_find(env, key->sym);
+
+    if (ith < env->count) {
+        lval_del(env->vals[ith]);
+        env->vals[ith] = lval_ref(value);
+
+        if (!env->frame) {
+            lenv_version++;
         }
+
+        return;
+    }
+
+    if (env->count == env->capacity) {
+        lenv_grow(env);
+    }
+
+    env->vals[env->count] = lval_ref(value);
+    env->syms[env->count] = key->sym;
+
+    if (env->frame) {
+        latom_of(key->sym)->frames++;
+    } else {
+        lenv_version++;
+    }
+
+    if (env->index) {
+        lenv_index(env, env->count);
     }
 
     env->count++;
-    env->vals = realloc(env->vals, sizeof(lval*) * env->count);
-    env->syms = realloc(env->syms, sizeof(char*) * env->count);
+}
 
-    env->vals[env->count - 1] = lval_copy(value);
-    env->syms[env->count - 1] = malloc(strlen(key->sym) + 1);
-    strcpy(env->syms[env->count - 1], key->sym); // NOLINT(clang-analyzer-security.insecureAPI.strcpy)
+void lenv_put(lenv* env, const lval* key, lval* value)
+{
+    if (env->flags & LALLOC_REGION) {
+        lenv_set(env, key, value);
+        return;
+    }
+
+    // `value` escapes the active region (if any) so it is
+    // promoted by copying it out under a heap scope.
+    lalloc_heap_begin();
+    lenv_set(env, key, value);
+    lalloc_heap_end();
 }
 
 lenv* lenv_copy(const lenv* env)
 {
-    lenv* nenv = malloc(sizeof(lenv));
+    lenv* nenv = lalloc_lenv();
     nenv->par = env->par;
+    nenv->frame = env->frame;
     nenv->count = env->count;
+    nenv->capacity = env->capacity;
 
-    nenv->syms = malloc(sizeof(char*) * nenv->count);
-    nenv->vals = malloc(sizeof(lval*) * nenv->count);
+    nenv->syms = lalloc_cells(nenv->capacity);
+    nenv->vals = lalloc_cells(nenv->capacity);
+    nenv->index = NULL;
 
     for (unsigned i = 0; i < env->count; i++) {
-        nenv->syms[i] = malloc(strlen(env->syms[i]) + 1);
-        strcpy(nenv->syms[i], env->syms[i]); // NOLINT(clang-analyzer-security.insecureAPI.strcpy)
-        nenv->vals[i] = lval_copy(env->vals[i]);
+        nenv->syms[i] = env->syms[i];
+        nenv->vals[i] = lval_ref(env->vals[i]);
+
+        if (nenv->frame) {
+            latom_of(nenv->syms[i])->frames++;
+        }
+    }
+
+    if (env->index) {
+        nenv->index = lalloc_cells(lenv_index_cells(nenv->capacity));
+        memcpy(nenv->index, env->index, sizeof(unsigned) * 2 * nenv->capacity); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
     }
 
     return nenv;
@@ -105,6 +263,26 @@ void lenv_def(lenv* env, const lval* key, lval* value)
     lenv_put(env, key, value);
 }
 
+int lenv_shadows(const lenv* env, const lenv* frame)
+{
+    if (!frame->frame) {
+        return 0;
+    }
+
+    for (unsigned i = 0; i < frame->count; i++) {
+        if (lenv_find(env, frame->syms[i]) == env->count) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+lenv_cache_stats lenv_get_cache_stats(void)
+{
+    return cache_stats;
+}
+
 void lenv_add_builtin(lenv* env, const char* name, lbuiltin func)
 {
     lval* key = lval_sym(name);
@@ -114,12 +292,18 @@ void lenv_add_builtin(lenv* env, const char* name, lbuiltin func)
     lval_del(value);
 }
 
+void lenv_set_native_prelude(int enabled)
+{
+    native_prelude = enabled;
+}
+
 void lenv_add_builtins(lenv* env)
 {
     lenv_add_builtin(env, "load", builtin_load);
     lenv_add_builtin(env, "print", builtin_print);
     // lenv_add_builtin(env, "input", builtin_);
     lenv_add_builtin(env, "error", builtin_error);
+    lenv_add_builtin(env, "cache-stats", builtin_cache_stats);
 
     lenv_add_builtin(env, "\\", builtin_lambda);
     lenv_add_builtin(env, "def", builtin_def);
@@ -143,4 +327,39 @@ void lenv_add_builtins(lenv* env)
     lenv_add_builtin(env, "<", builtin_lt);
     lenv_add_builtin(env, ">=", builtin_ge);
     lenv_add_builtin(env, "<=", builtin_le);
+
+    lenv_add_builtin(env, "while", builtin_while);
+    lenv_add_builtin(env, "loop", builtin_loop);
+    lenv_add_builtin(env, "recur", builtin_recur);
+    lenv_add_builtin(env, "for-range", builtin_for_range);
+
+    lenv_add_builtin(env, "native", builtin_native);
+
+    if (!native_prelude) {
+        return;
+    }
+
+    lenv_add_builtin(env, "do", builtin_do);
+    lenv_add_builtin(env, "let", builtin_let);
+    lenv_add_builtin(env, "select", builtin_select);
+    lenv_add_builtin(env, "case", builtin_case);
+    lenv_add_builtin(env, "and", builtin_and);
+    lenv_add_builtin(env, "or", builtin_or);
+
+    lenv_add_builtin(env, "len", builtin_len);
+    lenv_add_builtin(env, "nth", builtin_nth);
+    lenv_add_builtin(env, "last", builtin_last);
+    lenv_add_builtin(env, "reverse", builtin_reverse);
+    lenv_add_builtin(env, "take", builtin_take);
+    lenv_add_builtin(env, "drop", builtin_drop);
+    lenv_add_builtin(env, "map", builtin_map);
+    lenv_add_builtin(env, "filter", builtin_filter);
+    lenv_add_builtin(env, "foldl", builtin_foldl);
+    lenv_add_builtin(env, "foldr", builtin_foldr);
+    lenv_add_builtin(env, "sum", builtin_sum);
+    lenv_add_builtin(env, "product", builtin_product);
+    lenv_add_builtin(env, "min", builtin_min);
+    lenv_add_builtin(env, "max", builtin_max);
+    lenv_add_builtin(env, "zip", builtin_zip);
+    lenv_add_builtin(env, "lookup", builtin_lookup);
 }
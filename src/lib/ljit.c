@@ -0,0 +1,765 @@
+// MAP_ANONYMOUS is not declared by strict ISO C builds.
+#define _DEFAULT_SOURCE
+
+#include <ljit.h>
+
+#include <builtin.h>
+#include <lenv.h>
+#include <lval.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// Native code is only emitted for x86-64 Linux.
+#if defined(__x86_64__) && defined(__linux__)
+#define LJIT_X86_64 1
+#include <sys/mman.h>
+#endif
+
+/// @brief Enum for what a symbol of a natively compiled body stands for
+///
+/// The possible kinds are:
+/// - LJIT_ADD ... LJIT_SELECT : the head of a call to the builtin of the same position in `ljit_builtins`
+/// - LJIT_SELF                : the head of a call to the lambda being compiled
+/// - LJIT_VALUE               : a symbol that is not a formal, bound to a number
+enum { LJIT_ADD,
+    LJIT_SUB,
+    LJIT_MUL,
+    LJIT_DIV,
+    LJIT_EQ,
+    LJIT_NE,
+    LJIT_GT,
+    LJIT_LT,
+    LJIT_GE,
+    LJIT_LE,
+    LJIT_IF,
+    LJIT_SELECT,
+    LJIT_SELF,
+    LJIT_VALUE };
+
+/// Builtins native code implements, in the order of their kinds.
+static const struct {
+    const char* name;
+    lbuiltin func;
+} ljit_builtins[] = {
+    { "+", builtin_add },
+    { "-", builtin_sub },
+    { "*", builtin_mul },
+    { "/", builtin_div },
+    { "==", builtin_eq },
+    { "!=", builtin_ne },
+    { ">", builtin_gt },
+    { "<", builtin_lt },
+    { ">=", builtin_ge },
+    { "<=", builtin_le },
+    { "if", builtin_if },
+    { "select", builtin_select },
+};
+
+/// Opcodes of the `setcc` instructions implementing the comparisons from LJIT_EQ on.
+static const unsigned char ljit_conditions[] = { 0x94, 0x95, 0x9F, 0x9C, 0x9D, 0x9E };
+
+/// @brief Represents a symbol native code relies on
+///
+/// A `ljit_sym` consists of a:
+/// - key       : lval* corresponding to the symbol, borrowed from the compiled body
+/// - kind      : int corresponding to what the symbol must stand for when the code runs
+typedef struct ljit_sym {
+    lval* key;
+    int kind;
+} ljit_sym;
+
+/// @brief Represents natively compiled code
+///
+/// A `ljit` consists of a:
+/// - mem       : unsigned char* corresponding to the executable memory holding the code
+/// - size      : size_t corresponding to the length of `mem`
+/// - body      : const lval* corresponding to the compiled body, identifying calls to the lambda itself
+/// - arity     : unsigned corresponding to the number of formals
+/// - params    : const char** corresponding to the interned names of the formals
+/// - args      : long* corresponding to the arguments passed to the code
+/// - count     : unsigned corresponding to the number of symbols in `syms`
+/// - syms      : ljit_sym* corresponding to the symbols checked before the code runs
+/// - values    : long* corresponding to the numbers bound to the LJIT_VALUE symbols, by position in `syms`
+/// - frame     : unsigned corresponding to the bytes of native stack each call uses
+/// - deopts    : unsigned corresponding to the number of runs that deoptimized
+struct ljit {
+    unsigned char* mem;
+    size_t size;
+    const lval* body;
+    unsigned arity;
+    const char** params;
+    long* args; // NOLINT(google-runtime-int)
+    unsigned count;
+    ljit_sym* syms;
+    long* values; // NOLINT(google-runtime-int)
+    unsigned frame;
+    unsigned deopts;
+};
+
+/// Signature of the entry of native code, returning 0 if it deoptimized.
+typedef int (*ljit_entry)(const long* args, long* result, long budget, const long* values); // NOLINT(google-runtime-int)
+
+static int enabled = 1;
+
+//////////////////////
+// Configuration
+//////////////////////
+
+void ljit_set_enabled(int enable)
+{
+    enabled = enable;
+}
+
+int ljit_enabled(void)
+{
+    return enabled;
+}
+
+//////////////////////
+// Compilation
+//////////////////////
+
+#if defined(LJIT_X86_64)
+
+/// @brief Represents code being emitted
+///
+/// A `ljit_asm` consists of a:
+/// - bytes     : unsigned char* corresponding to the machine code emitted so far
+/// - count     : unsigned corresponding to the length of the code
+/// - capacity  : unsigned corresponding to the length of `bytes`
+/// - jit       : ljit* corresponding to the code being compiled
+/// - formals   : const lval* corresponding to the formals of the lambda
+/// - body      : unsigned corresponding to the offset of the compiled body
+/// - deopt     : unsigned corresponding to the offset of the code leaving through a deoptimization
+/// - temps     : unsigned corresponding to the values pushed by the body at this point
+/// - most      : unsigned corresponding to the most values the body pushes
+///
+/// Within the body rax holds the value of the expression
+/// compiled last, rbp points to the arguments of the
+/// current call, r12 counts the calls that may still be
+/// nested and r15 points to `values`. The entry keeps the
+/// stack pointer to restore on a deoptimization in r13.
+typedef struct ljit_asm {
+    unsigned char* bytes;
+    unsigned count;
+    unsigned capacity;
+    ljit* jit;
+    const lval* formals;
+    unsigned body;
+    unsigned deopt;
+    unsigned temps;
+    unsigned most;
+} ljit_asm;
+
+/// Appends `count` bytes of machine code.
+static void ljit_emit(ljit_asm* code, unsigned count, const unsigned char* bytes)
+{
+    if (code->count + count > code->capacity) {
+        code->capacity = code->capacity ? 2 * code->capacity : 256;
+        code->bytes = realloc(code->bytes, code->capacity);
+
+        if (!code->bytes) {
+            exit(1); // NOLINT(concurrency-mt-unsafe)
+        }
+    }
+
+    memcpy(code->bytes + code->count, bytes, count); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+    code->count += count;
+}
+
+/// Appends the bytes listed after `code`.
+#define LJIT_EMIT(code, ...)                                                \
+    ljit_emit(code, sizeof((const unsigned char[]) { __VA_ARGS__ }), \
+        (const unsigned char[]) { __VA_ARGS__ })
+
+/// Appends `value` as `count` little-endian bytes.
+static void ljit_emit_imm(ljit_asm* code, uint64_t value, unsigned count)
+{
+    unsigned char bytes[8];
+
+    for (unsigned i = 0; i < count; i++) {
+        bytes[i] = (unsigned char)(value >> (8 * i));
+    }
+
+    ljit_emit(code, count, bytes);
+}
+
+/// Points the 32 bit displacement at `at` to `target`.
+static void ljit_patch(ljit_asm* code, unsigned at, unsigned target)
+{
+    uint32_t rel = (uint32_t)target - (uint32_t)(at + 4);
+
+    for (unsigned i = 0; i < 4; i++) {
+        code->bytes[at + i] = (unsigned char)(rel >> (8 * i));
+    }
+}
+
+/// Appends a displacement to `target`, returning its offset.
+static unsigned ljit_emit_rel(ljit_asm* code, unsigned target)
+{
+    unsigned at = code->count;
+    ljit_emit_imm(code, 0, 4);
+    ljit_patch(code, at, target);
+    return at;
+}
+
+/// Appends a jump to the deoptimization taken on the condition `jcc`.
+static void ljit_emit_deopt(ljit_asm* code, unsigned char jcc)
+{
+    LJIT_EMIT(code, 0x0F, jcc);
+    ljit_emit_rel(code, code->deopt);
+}
+
+/// Appends a jump to be patched by ljit_patch_chain, chaining it onto `chain`.
+static void ljit_emit_chain(ljit_asm* code, unsigned* chain)
+{
+    LJIT_EMIT(code, 0xE9);
+    unsigned at = code->count;
+    ljit_emit_imm(code, *chain, 4);
+    *chain = at + 1;
+}
+
+/// Points every jump chained onto `chain` at the end of the code.
+static void ljit_patch_chain(ljit_asm* code, unsigned chain)
+{
+    while (chain) {
+        unsigned at = chain - 1;
+        chain = (unsigned)code->bytes[at] | (unsigned)code->bytes[at + 1] << 8
+            | (unsigned)code->bytes[at + 2] << 16 | (unsigned)code->bytes[at + 3] << 24;
+        ljit_patch(code, at, code->count);
+    }
+}
+
+/// Appends `push rax`.
+static void ljit_emit_push(ljit_asm* code)
+{
+    LJIT_EMIT(code, 0x50);
+    code->temps++;
+    code->most = code->temps > code->most ? code->temps : code->most;
+}
+
+/// Moves the value last compiled to rcx and pops the one pushed before it into rax.
+static void ljit_emit_operands(ljit_asm* code)
+{
+    LJIT_EMIT(code, 0x48, 0x89, 0xC1, 0x58);
+    code->temps--;
+}
+
+/// Returns the position of `key` among the formals, or -1.
+static int ljit_param(const ljit_asm* code, const lval* key)
+{
+    for (unsigned i = 0; i < code->formals->count; i++) {
+        if (code->formals->cell[i]->sym == key->sym) {
+            return (int)i;
+        }
+    }
+
+    return -1;
+}
+
+/// Returns the kind of call `key` is the head of.
+static int ljit_kind(const lval* key)
+{
+    for (int kind = 0; kind < LJIT_SELF; kind++) {
+        if (strcmp(key->sym, ljit_builtins[kind].name) == 0) {
+            return kind;
+        }
+    }
+
+    return LJIT_SELF;
+}
+
+/// Records that `key` must stand for `kind`, returning its position or -1 if it must already stand for another.
+static int ljit_expect(ljit_asm* code, lval* key, int kind)
+{
+    ljit* jit = code->jit;
+
+    for (unsigned i = 0; i < jit->count; i++) {
+        if (jit->syms[i].key->sym == key->sym) {
+            return jit->syms[i].kind == kind ? (int)i : -1;
+        }
+    }
+
+    jit->syms = realloc(jit->syms, sizeof(ljit_sym) * (jit->count + 1));
+
+    if (!jit->syms) {
+        exit(1); // NOLINT(concurrency-mt-unsafe)
+    }
+
+    jit->syms[jit->count].key = key;
+    jit->syms[jit->count].kind = kind;
+
+    return (int)jit->count++;
+}
+
+static int ljit_compile_sexpr(ljit_asm* code, const lval* sexpr);
+
+/// Compiles `obj` to leave its value in rax, returning 0 if it cannot be compiled.
+static int ljit_compile_expr(ljit_asm* code, lval* obj)
+{
+    switch (lval_type(obj)) {
+    case LVAL_NUM:
+        LJIT_EMIT(code, 0x48, 0xB8);
+        ljit_emit_imm(code, (uint64_t)lval_num_value(obj), 8);
+        return 1;
+
+    case LVAL_SYM: {
+        int ith = ljit_param(code, obj);
+
+        if (ith >= 0) {
+            LJIT_EMIT(code, 0x48, 0x8B, 0x85);
+            ljit_emit_imm(code, 16 + 8 * (unsigned)ith, 4);
+            return 1;
+        }
+
+        ith = ljit_expect(code, obj, LJIT_VALUE);
+
+        if (ith < 0) {
+            return 0;
+        }
+
+        LJIT_EMIT(code, 0x49, 0x8B, 0x87);
+        ljit_emit_imm(code, 8 * (unsigned)ith, 4);
+        return 1;
+    }
+
+    case LVAL_SEXPR:
+        return ljit_compile_sexpr(code, obj);
+
+    default:
+        return 0;
+    }
+}
+
+/// Compiles a call of `+`, `-`, `*` or `/`.
+///
+/// A divisor of zero, or of -1 which could overflow,
+/// deoptimizes so the builtin reports or handles it.
+static int ljit_compile_arith(ljit_asm* code, const lval* sexpr, int kind)
+{
+    if (!ljit_compile_expr(code, sexpr->cell[1])) {
+        return 0;
+    }
+
+    if (sexpr->count == 2 && kind == LJIT_SUB) {
+        LJIT_EMIT(code, 0x48, 0xF7, 0xD8);
+    }
+
+    for (unsigned i = 2; i < sexpr->count; i++) {
+        ljit_emit_push(code);
+
+        if (!ljit_compile_expr(code, sexpr->cell[i])) {
+            return 0;
+        }
+
+        ljit_emit_operands(code);
+
+        switch (kind) {
+        case LJIT_ADD:
+            LJIT_EMIT(code, 0x48, 0x01, 0xC8);
+            break;
+
+        case LJIT_SUB:
+            LJIT_EMIT(code, 0x48, 0x29, 0xC8);
+            break;
+
+        case LJIT_MUL:
+            LJIT_EMIT(code, 0x48, 0x0F, 0xAF, 0xC1);
+            break;
+
+        default:
+            LJIT_EMIT(code, 0x48, 0x85, 0xC9);
+            ljit_emit_deopt(code, 0x84);
+            LJIT_EMIT(code, 0x48, 0x83, 0xF9, 0xFF);
+            ljit_emit_deopt(code, 0x84);
+            LJIT_EMIT(code, 0x48, 0x99, 0x48, 0xF7, 0xF9);
+            break;
+        }
+    }
+
+    return 1;
+}
+
+/// Compiles a comparison of two numbers, leaving 1 or 0.
+static int ljit_compile_compare(ljit_asm* code, const lval* sexpr, int kind)
+{
+    if (sexpr->count != 3 || !ljit_compile_expr(code, sexpr->cell[1])) {
+        return 0;
+    }
+
+    ljit_emit_push(code);
+
+    if (!ljit_compile_expr(code, sexpr->cell[2])) {
+        return 0;
+    }
+
+    ljit_emit_operands(code);
+    LJIT_EMIT(code, 0x48, 0x39, 0xC8, 0x0F, ljit_conditions[kind - LJIT_EQ], 0xC0, 0x0F, 0xB6, 0xC0);
+    return 1;
+}
+
+/// Compiles an `if` whose branches are literal Q-Expressions.
+static int ljit_compile_if(ljit_asm* code, const lval* sexpr)
+{
+    if (sexpr->count != 4
+        || lval_type(sexpr->cell[2]) != LVAL_QEXPR || lval_type(sexpr->cell[3]) != LVAL_QEXPR
+        || !ljit_compile_expr(code, sexpr->cell[1])) {
+        return 0;
+    }
+
+    LJIT_EMIT(code, 0x48, 0x85, 0xC0, 0x0F, 0x84);
+    unsigned other = ljit_emit_rel(code, 0);
+    unsigned done = 0;
+
+    if (!ljit_compile_sexpr(code, sexpr->cell[2])) {
+        return 0;
+    }
+
+    ljit_emit_chain(code, &done);
+    ljit_patch(code, other, code->count);
+
+    if (!ljit_compile_sexpr(code, sexpr->cell[3])) {
+        return 0;
+    }
+
+    ljit_patch_chain(code, done);
+    return 1;
+}
+
+/// Compiles a `select` whose clauses are literal Q-Expressions, deoptimizing if none is selected.
+static int ljit_compile_select(ljit_asm* code, const lval* sexpr)
+{
+    unsigned done = 0;
+
+    for (unsigned i = 1; i < sexpr->count; i++) {
+        const lval* clause = sexpr->cell[i];
+
+        if (lval_type(clause) != LVAL_QEXPR || clause->count < 2
+            || !ljit_compile_expr(code, clause->cell[0])) {
+            return 0;
+        }
+
+        LJIT_EMIT(code, 0x48, 0x85, 0xC0, 0x0F, 0x84);
+        unsigned next = ljit_emit_rel(code, 0);
+
+        if (!ljit_compile_expr(code, clause->cell[1])) {
+            return 0;
+        }
+
+        ljit_emit_chain(code, &done);
+        ljit_patch(code, next, code->count);
+    }
+
+    LJIT_EMIT(code, 0xE9);
+    ljit_emit_rel(code, code->deopt);
+
+    ljit_patch_chain(code, done);
+    return 1;
+}
+
+/// Compiles a call of the lambda itself with all of its arguments.
+///
+/// The arguments are pushed last to first, so the callee
+/// finds the `i`th above its return address and saved rbp.
+static int ljit_compile_call(ljit_asm* code, const lval* sexpr)
+{
+    unsigned arity = code->jit->arity;
+
+    if (sexpr->count != arity + 1) {
+        return 0;
+    }
+
+    LJIT_EMIT(code, 0x49, 0xFF, 0xCC);
+    ljit_emit_deopt(code, 0x84);
+
+    for (unsigned i = arity; i > 0; i--) {
+        if (!ljit_compile_expr(code, sexpr->cell[i])) {
+            return 0;
+        }
+
+        ljit_emit_push(code);
+    }
+
+    LJIT_EMIT(code, 0xE8);
+    ljit_emit_rel(code, code->body);
+
+    if (arity) {
+        LJIT_EMIT(code, 0x48, 0x81, 0xC4);
+        ljit_emit_imm(code, 8 * arity, 4);
+        code->temps -= arity;
+    }
+
+    LJIT_EMIT(code, 0x49, 0xFF, 0xC4);
+    return 1;
+}
+
+/// Compiles the children of `sexpr` evaluated as an S-Expression.
+static int ljit_compile_sexpr(ljit_asm* code, const lval* sexpr)
+{
+    if (sexpr->count == 0) {
+        return 0;
+    }
+
+    // `(x)` evaluates to `x`.
+    if (sexpr->count == 1) {
+        return ljit_compile_expr(code, sexpr->cell[0]);
+    }
+
+    lval* head = sexpr->cell[0];
+
+    if (lval_type(head) != LVAL_SYM || ljit_param(code, head) >= 0) {
+        return 0;
+    }
+
+    int kind = ljit_kind(head);
+
+    if (ljit_expect(code, head, kind) < 0) {
+        return 0;
+    }
+
+    switch (kind) {
+    case LJIT_ADD:
+    case LJIT_SUB:
+    case LJIT_MUL:
+    case LJIT_DIV:
+        return ljit_compile_arith(code, sexpr, kind);
+
+    case LJIT_IF:
+        return ljit_compile_if(code, sexpr);
+
+    case LJIT_SELECT:
+        return ljit_compile_select(code, sexpr);
+
+    case LJIT_SELF:
+        return ljit_compile_call(code, sexpr);
+
+    default:
+        return ljit_compile_compare(code, sexpr, kind);
+    }
+}
+
+/// Emits the entry of the code followed by its body, returning 0 if the body cannot be compiled.
+///
+/// The entry saves the registers the body uses, pushes
+/// the arguments and calls the body, storing its result.
+/// A deoptimization restores the stack pointer saved in
+/// r13 and returns 0 instead.
+static int ljit_compile_code(ljit_asm* code, lval* body)
+{
+    unsigned arity = code->jit->arity;
+
+    LJIT_EMIT(code, 0x55, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57);
+    LJIT_EMIT(code, 0x49, 0x89, 0xD4, 0x49, 0x89, 0xF6, 0x49, 0x89, 0xCF, 0x49, 0x89, 0xE5);
+
+    for (unsigned i = arity; i > 0; i--) {
+        LJIT_EMIT(code, 0xFF, 0xB7);
+        ljit_emit_imm(code, 8 * (i - 1), 4);
+    }
+
+    LJIT_EMIT(code, 0xE8);
+    unsigned call = ljit_emit_rel(code, 0);
+
+    if (arity) {
+        LJIT_EMIT(code, 0x48, 0x81, 0xC4);
+        ljit_emit_imm(code, 8 * arity, 4);
+    }
+
+    LJIT_EMIT(code, 0x49, 0x89, 0x06, 0xB8, 0x01, 0x00, 0x00, 0x00, 0xEB, 0x05);
+
+    code->deopt = code->count;
+    LJIT_EMIT(code, 0x4C, 0x89, 0xEC, 0x31, 0xC0);
+    LJIT_EMIT(code, 0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5D, 0xC3);
+
+    code->body = code->count;
+    ljit_patch(code, call, code->body);
+
+    LJIT_EMIT(code, 0x55, 0x48, 0x89, 0xE5);
+
+    if (!ljit_compile_sexpr(code, body)) {
+        return 0;
+    }
+
+    LJIT_EMIT(code, 0x5D, 0xC3);
+    return 1;
+}
+
+/// Copies the emitted code into executable memory, returning 0 if it cannot be mapped.
+static int ljit_map(ljit* jit, const ljit_asm* code)
+{
+    void* mem = mmap(NULL, code->count, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (mem == MAP_FAILED) {
+        return 0;
+    }
+
+    memcpy(mem, code->bytes, code->count); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+
+    if (mprotect(mem, code->count, PROT_READ | PROT_EXEC) != 0) {
+        munmap(mem, code->count);
+        return 0;
+    }
+
+    jit->mem = mem;
+    jit->size = code->count;
+    return 1;
+}
+
+#endif
+
+ljit* ljit_compile(const lval* formals, lval* body)
+{
+#if defined(LJIT_X86_64)
+    if (!enabled) {
+        return NULL;
+    }
+
+    for (unsigned i = 0; i < formals->count; i++) {
+        if (strcmp(formals->cell[i]->sym, "&") == 0) {
+            return NULL;
+        }
+
+        for (unsigned j = 0; j < i; j++) {
+            if (formals->cell[j]->sym == formals->cell[i]->sym) {
+                return NULL;
+            }
+        }
+    }
+
+    ljit* jit = malloc(sizeof(ljit));
+
+    if (!jit) {
+        exit(1); // NOLINT(concurrency-mt-unsafe)
+    }
+
+    jit->mem = NULL;
+    jit->size = 0;
+    jit->body = body;
+    jit->arity = formals->count;
+    jit->params = malloc(sizeof(const char*) * (jit->arity + 1));
+    jit->args = malloc(sizeof(long) * (jit->arity + 1)); // NOLINT(google-runtime-int)
+    jit->count = 0;
+    jit->syms = NULL;
+    jit->values = NULL;
+    jit->deopts = 0;
+
+    if (!jit->params || !jit->args) {
+        exit(1); // NOLINT(concurrency-mt-unsafe)
+    }
+
+    for (unsigned i = 0; i < jit->arity; i++) {
+        jit->params[i] = formals->cell[i]->sym;
+    }
+
+    ljit_asm code = { NULL, 0, 0, jit, formals, 0, 0, 0, 0 };
+    int compiled = ljit_compile_code(&code, body);
+
+    if (compiled) {
+        jit->frame = 8 * (2 + code.most);
+        jit->values = malloc(sizeof(long) * (jit->count + 1)); // NOLINT(google-runtime-int)
+
+        if (!jit->values) {
+            exit(1); // NOLINT(concurrency-mt-unsafe)
+        }
+
+        compiled = ljit_map(jit, &code);
+    }
+
+    free(code.bytes);
+
+    if (!compiled) {
+        ljit_del(jit);
+        return NULL;
+    }
+
+    return jit;
+#else
+    (void)formals;
+    (void)body;
+    return NULL;
+#endif
+}
+
+void ljit_del(ljit* jit)
+{
+#if defined(LJIT_X86_64)
+    if (jit->mem) {
+        munmap(jit->mem, jit->size);
+    }
+#endif
+
+    free(jit->params);
+    free(jit->args);
+    free(jit->syms);
+    free(jit->values);
+    free(jit);
+}
+
+//////////////////////
+// Execution
+//////////////////////
+
+/// Checks if `value`, bound to a symbol of `jit`, is what the symbol must stand for.
+static int ljit_check(const ljit* jit, const ljit_sym* sym, const lval* value)
+{
+    switch (sym->kind) {
+    case LJIT_VALUE:
+        return lval_type(value) == LVAL_NUM;
+
+    case LJIT_SELF:
+        return lval_type(value) == LVAL_FUN && !value->builtin
+            && value->body == jit->body && !value->bound;
+
+    default:
+        return lval_type(value) == LVAL_FUN && value->builtin == ljit_builtins[sym->kind].func;
+    }
+}
+
+lval* ljit_run(ljit* jit, lenv* frame)
+{
+    if (jit->deopts >= LJIT_MAX_DEOPTS || frame->count != jit->arity) {
+        return NULL;
+    }
+
+    for (unsigned i = 0; i < jit->arity; i++) {
+        if (frame->syms[i] != jit->params[i] || lval_type(frame->vals[i]) != LVAL_NUM) {
+            return NULL;
+        }
+
+        jit->args[i] = lval_num_value(frame->vals[i]);
+    }
+
+    // The body has no side effects, so the symbols keep
+    // the bindings found here until the code returns.
+    for (unsigned i = 0; i < jit->count; i++) {
+        lval* value = lenv_get(frame, jit->syms[i].key);
+        int expected = ljit_check(jit, jit->syms + i, value);
+
+        if (expected && jit->syms[i].kind == LJIT_VALUE) {
+            jit->values[i] = lval_num_value(value);
+        }
+
+        lval_del(value);
+
+        if (!expected) {
+            return NULL;
+        }
+    }
+
+    unsigned budget = LJIT_STACK_BYTES / jit->frame;
+    unsigned depth = lval_max_depth() > lval_depth() ? lval_max_depth() - lval_depth() : 0;
+    budget = depth < budget ? depth : budget;
+
+    ljit_entry entry = NULL;
+    memcpy(&entry, &jit->mem, sizeof(entry)); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+
+    long result = 0; // NOLINT(google-runtime-int)
+
+    if (budget == 0 || !entry(jit->args, &result, budget, jit->values)) {
+        jit->deopts++;
+        return NULL;
+    }
+
+    return lval_num(result);
+}
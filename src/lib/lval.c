@@ -1,8 +1,14 @@
+// ucontext.h is not declared by strict ISO C builds.
+#define _DEFAULT_SOURCE
+
 #include <lval.h>
 
 #include <builtin.h>
 #include <io.h>
+#include <lalloc.h>
+#include <latom.h>
 #include <lenv.h>
+#include <lvm.h>
 #include <macros.h>
 #include <utilities.h>
 
@@ -11,30 +17,65 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+/// Tree-walking evaluations go on in stack segments allocated on the heap once the native stack runs low, on Linux.
+#if defined(__linux__)
+#define LVAL_STACK_SEGMENTS 1
+#include <ucontext.h>
+#endif
+
+/// Size in bytes of each stack segment.
+#define LVAL_SEGMENT_BYTES ((size_t)8 << 20)
+
+/// Limit on the number of nested evaluations.
+static unsigned max_depth = LVAL_MAX_DEPTH;
+
+/// Number of evaluations currently nested.
+static unsigned eval_depth = 0;
+
+/// Address of the outermost evaluation on the current stack, and how many bytes of stack may be used past it.
+static uintptr_t native_base = 0;
+static uintptr_t native_limit = 0;
+
 ///////////////////////////
 // `lval` Constructors
 ///////////////////////////
 
+/// Allocates an lval of `type` with a single owner.
+static lval* lval_alloc(int type)
+{
+    lval* obj = lalloc_lval();
+    obj->type = (unsigned char)type;
+    obj->refs = 1;
+    return obj;
+}
+
 lval* lval_num(const long num)
 {
-    lval* nnumval = malloc(sizeof(lval));
-    nnumval->type = LVAL_NUM;
+    if ((intmax_t)num >= (INTPTR_MIN >> 1) && (intmax_t)num <= (INTPTR_MAX >> 1)) { // NOLINT(hicpp-signed-bitwise)
+        return (lval*)(((uintptr_t)num << 1) | LVAL_FIXNUM_TAG); // NOLINT(performance-no-int-to-ptr)
+    }
+
+    lval* nnumval = lval_alloc(LVAL_NUM);
     nnumval->num = num;
     return nnumval;
 }
 
 lval* lval_err(const char* fmt, ...)
 {
-    lval* nerrval = malloc(sizeof(lval));
-    nerrval->type = LVAL_ERR;
+    lval* nerrval = lval_alloc(LVAL_ERR);
 
     va_list var_list;
     va_start(var_list, fmt);
 
-    nerrval->err = malloc(MAX_ERR_STR_SIZE);
-    vsnprintf(nerrval->err, MAX_ERR_STR_SIZE - 1, fmt, var_list); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling, clang-diagnostic-format-nonliteral)
+    char err[MAX_ERR_STR_SIZE];
+    vsnprintf(err, MAX_ERR_STR_SIZE - 1, fmt, var_list); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling, clang-diagnostic-format-nonliteral)
 
-    nerrval->err = realloc(nerrval->err, strlen(nerrval->err) + 1);
+    nerrval->err = lalloc_chars(strlen(err) + 1);
+    strcpy(nerrval->err, err); // NOLINT(clang-analyzer-security.insecureAPI.strcpy)
 
     va_end(var_list);
     return nerrval;
@@ -42,59 +83,86 @@ lval* lval_err(const char* fmt, ...)
 
 lval* lval_sym(const char* sym)
 {
-    lval* nsymval = malloc(sizeof(lval));
-    nsymval->type = LVAL_SYM;
-    nsymval->sym = malloc(strlen(sym) + 1);
-    strcpy(nsymval->sym, sym); // NOLINT(clang-analyzer-security.insecureAPI.strcpy)
+    lval* nsymval = lval_alloc(LVAL_SYM);
+    nsymval->sym = latom_intern(sym);
+    nsymval->slot = LVAL_NO_SLOT;
+    nsymval->version = 0;
+    nsymval->cached = NULL;
+    return nsymval;
+}
+
+lval* lval_sym_n(const char* sym, size_t len)
+{
+    lval* nsymval = lval_alloc(LVAL_SYM);
+    nsymval->sym = latom_intern_n(sym, len);
+    nsymval->slot = LVAL_NO_SLOT;
+    nsymval->version = 0;
+    nsymval->cached = NULL;
     return nsymval;
 }
 
 lval* lval_str(const char* str)
 {
-    lval* nstrval = malloc(sizeof(lval));
-    nstrval->type = LVAL_STR;
-    nstrval->str = malloc(strlen(str) + 1);
+    lval* nstrval = lval_alloc(LVAL_STR);
+    nstrval->str = lalloc_chars(strlen(str) + 1);
     strcpy(nstrval->str, str); // NOLINT(clang-analyzer-security.insecureAPI.strcpy)
     return nstrval;
 }
 
 lval* lval_sexpr(void)
 {
-    lval* nsexprval = malloc(sizeof(lval));
-    nsexprval->type = LVAL_SEXPR;
+    lval* nsexprval = lval_alloc(LVAL_SEXPR);
     nsexprval->count = 0;
+    nsexprval->capacity = 0;
     nsexprval->cell = NULL;
+    nsexprval->offset = 0;
+    nsexprval->owner = NULL;
     return nsexprval;
 }
 
 lval* lval_qexpr(void)
 {
-    lval* nqexprval = malloc(sizeof(lval));
-    nqexprval->type = LVAL_QEXPR;
+    lval* nqexprval = lval_alloc(LVAL_QEXPR);
     nqexprval->count = 0;
+    nqexprval->capacity = 0;
     nqexprval->cell = NULL;
+    nqexprval->offset = 0;
+    nqexprval->owner = NULL;
     return nqexprval;
 }
 
 lval* lval_fun(lbuiltin func)
 {
-    lval* nfunval = malloc(sizeof(lval));
-    nfunval->type = LVAL_FUN;
+    lval* nfunval = lval_alloc(LVAL_FUN);
     nfunval->builtin = func;
     return nfunval;
 }
 
 lval* lval_lambda(lval* formals, lval* body) // NOLINT(bugprone-easily-swappable-parameters)
 {
-    lval* nlambdaval = malloc(sizeof(lval));
-    nlambdaval->type = LVAL_FUN;
+    lval* nlambdaval = lval_alloc(LVAL_FUN);
 
     nlambdaval->builtin = NULL;
-
-    nlambdaval->env = lenv_new();
+    nlambdaval->bound = NULL;
 
     nlambdaval->formals = formals;
     nlambdaval->body = body;
+
+    if (!lvm_enabled()) {
+        nlambdaval->code = NULL;
+        return nlambdaval;
+    }
+
+    // Code outlives any region, so the body of a lambda
+    // created in one moves to the heap first and the
+    // lambda shares it with its code.
+    if (body->flags & LALLOC_REGION) {
+        lalloc_heap_begin();
+        nlambdaval->body = lval_ref(body);
+        lalloc_heap_end();
+    }
+
+    nlambdaval->code = lvm_compile(nlambdaval->body);
     return nlambdaval;
 }
 
@@ -103,60 +171,160 @@ lval* lval_lambda(lval* formals, lval* body) // NOLINT(bugprone-easily-swappable
 /////////////////////////
 
 void lval_del(lval* obj)
+{
+    if (lval_is_fixnum(obj) || ((obj->flags & LALLOC_REGION) && !lalloc_region_overflowed())) {
+        return;
+    }
+
+    if (--obj->refs > 0) {
+        return;
+    }
+
+    lval_release(obj);
+}
+
+void lval_release(lval* obj)
 {
     switch (obj->type) {
     case LVAL_NUM:
         break;
 
     case LVAL_ERR:
-        free(obj->err);
-        break;
-
-    case LVAL_SYM:
-        free(obj->sym);
+        lalloc_chars_free(obj->err);
         break;
 
     case LVAL_STR:
-        free(obj->str);
+        lalloc_chars_free(obj->str);
         break;
 
     case LVAL_FUN:
         if (!obj->builtin) {
-            lenv_del(obj->env);
+            if (obj->bound) {
+                lval_del(obj->bound);
+            }
+
             lval_del(obj->formals);
             lval_del(obj->body);
+
+            if (obj->code) {
+                lvm_code_del(obj->code);
+            }
         }
         break;
 
     case LVAL_QEXPR:
     case LVAL_SEXPR:
+        if (obj->owner) {
+            lval_del(obj->owner);
+            break;
+        }
+
         for (unsigned i = 0; i < obj->count; i++) {
             lval_del(obj->cell[i]);
         }
 
-        free(obj->cell);
+        lval_free_cells(obj);
         break;
     }
 
-    free(obj);
+    lalloc_lval_free(obj);
+}
+
+void lval_free_cells(lval* obj)
+{
+    if (obj->cell) {
+        lalloc_cells_free(obj->cell - obj->offset, obj->capacity);
+    }
+
+    obj->count = 0;
+    obj->capacity = 0;
+    obj->cell = NULL;
+    obj->offset = 0;
 }
 
 //////////////////////
 // `lval` Methods
 //////////////////////
 
+/// Reallocates the cells of `obj` with room for `front` more before its first and `back` more after its last.
+static void lval_regrow(lval* obj, unsigned front, unsigned back)
+{
+    unsigned needed = front + obj->count + back;
+
+    // Appending to an array with no leading slack grows it
+    // in place when the allocator can.
+    if (obj->offset == 0 && front == 0) {
+        unsigned capacity = needed > 2 * obj->capacity ? needed : 2 * obj->capacity;
+        capacity = capacity < 4 ? 4 : capacity;
+
+        obj->cell = lalloc_cells_resize(obj->cell, obj->capacity, capacity);
+        obj->capacity = capacity;
+        return;
+    }
+
+    // Otherwise the elements are moved so the slack left
+    // over is split between both ends, keeping repeated
+    // growth at either end amortised constant.
+    lval** old = obj->cell ? obj->cell - obj->offset : NULL;
+    lval** base = old;
+    unsigned capacity = obj->capacity;
+
+    if (2 * needed > capacity) {
+        capacity = 2 * needed;
+        base = lalloc_cells(capacity);
+    }
+
+    unsigned offset = front + (front ? (capacity - needed) / 2 : 0);
+
+    if (obj->count) {
+        memmove(base + offset, obj->cell, sizeof(lval*) * obj->count); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+    }
+
+    if (base != old) {
+        lalloc_cells_free(old, obj->capacity);
+    }
+
+    obj->capacity = capacity;
+    obj->cell = base + offset;
+    obj->offset = offset;
+}
+
+/// Makes room in `obj` for `front` more cells before its first and `back` more after its last.
+static void lval_reserve(lval* obj, unsigned front, unsigned back)
+{
+    if (obj->offset >= front && obj->capacity - obj->offset - obj->count >= back) {
+        return;
+    }
+
+    // The cells of a heap lval stay on the heap while a
+    // region is active.
+    int heap = !(obj->flags & LALLOC_REGION);
+
+    if (heap) {
+        lalloc_heap_begin();
+    }
+
+    lval_regrow(obj, front, back);
+
+    if (heap) {
+        lalloc_heap_end();
+    }
+}
+
 lval* lval_add(lval* parent, lval* child)
 {
-    parent->count++;
-    parent->cell = realloc(parent->cell, sizeof(lval*) * parent->count);
-    parent->cell[parent->count - 1] = child;
+    lval_reserve(parent, 0, 1);
+    parent->cell[parent->count++] = child;
     return parent;
 }
 
 lval* lval_copy(const lval* obj)
 {
-    lval* nval = malloc(sizeof(lval));
-    nval->type = obj->type;
+    if (lval_is_fixnum(obj)) {
+        return lval_num(lval_num_value(obj));
+    }
+
+    lval* nval = lval_alloc(obj->type);
 
     switch (obj->type) {
     case LVAL_FUN:
@@ -164,9 +332,10 @@ lval* lval_copy(const lval* obj)
             nval->builtin = obj->builtin;
         } else {
             nval->builtin = NULL;
-            nval->env = lenv_copy(obj->env);
-            nval->formals = lval_copy(obj->formals);
-            nval->body = lval_copy(obj->body);
+            nval->bound = obj->bound ? lval_ref(obj->bound) : NULL;
+            nval->formals = lval_ref(obj->formals);
+            nval->body = lval_ref(obj->body);
+            nval->code = obj->code ? lvm_code_ref(obj->code) : NULL;
         }
         break;
 
@@ -175,26 +344,31 @@ lval* lval_copy(const lval* obj)
         break;
 
     case LVAL_ERR:
-        nval->err = malloc(strlen(obj->err) + 1);
+        nval->err = lalloc_chars(strlen(obj->err) + 1);
         strcpy(nval->err, obj->err); // NOLINT(clang-analyzer-security.insecureAPI.strcpy)
         break;
 
     case LVAL_SYM:
-        nval->sym = malloc(strlen(obj->sym) + 1);
-        strcpy(nval->sym, obj->sym); // NOLINT(clang-analyzer-security.insecureAPI.strcpy)
+        nval->sym = obj->sym;
+        nval->slot = obj->slot;
+        nval->version = obj->version;
+        nval->cached = obj->cached;
         break;
 
     case LVAL_STR:
-        nval->str = malloc(strlen(obj->str) + 1);
+        nval->str = lalloc_chars(strlen(obj->str) + 1);
         strcpy(nval->str, obj->str); // NOLINT(clang-analyzer-security.insecureAPI.strcpy)
         break;
 
     case LVAL_SEXPR:
     case LVAL_QEXPR:
         nval->count = obj->count;
-        nval->cell = malloc(sizeof(lval*) * nval->count);
+        nval->capacity = obj->count;
+        nval->cell = lalloc_cells(nval->count);
+        nval->offset = 0;
+        nval->owner = NULL;
         for (unsigned i = 0; i < nval->count; i++) {
-            nval->cell[i] = lval_copy(obj->cell[i]);
+            nval->cell[i] = lval_ref(obj->cell[i]);
         }
 
         break;
@@ -203,118 +377,754 @@ lval* lval_copy(const lval* obj)
     return nval;
 }
 
+lval* lval_ref(lval* obj)
+{
+    if (lval_is_fixnum(obj)) {
+        return obj;
+    }
+
+    // Region lvals release what they borrow from the heap
+    // when the region ends, but do not survive it, so only
+    // a region lval referenced from the heap is copied.
+    if ((obj->flags & LALLOC_REGION) && !lalloc_region_active()) {
+        return lval_copy(obj);
+    }
+
+    obj->refs++;
+    return obj;
+}
+
+/// Checks if `obj` has a single owner that may modify it in place.
+static int lval_is_unique(const lval* obj)
+{
+    // Heap lvals are left alone while a region is active
+    // so they never come to hold region lvals.
+    return obj->refs == 1 && ((obj->flags & LALLOC_REGION) || !lalloc_region_active());
+}
+
+lval* lval_unshare(lval* obj)
+{
+    if (lval_is_fixnum(obj)) {
+        return obj;
+    }
+
+    int slice = (obj->type == LVAL_SEXPR || obj->type == LVAL_QEXPR) && obj->owner;
+
+    if (lval_is_unique(obj) && !slice) {
+        return obj;
+    }
+
+    lval* nval = lval_copy(obj);
+    lval_del(obj);
+    return nval;
+}
+
 lval* lval_pop(lval* obj, unsigned ith)
 {
     if (obj->count == 0) {
-        return lval_err("Symbol: '%s' has no children", obj->sym);
+        return lval_err("%s has no children", ltype_name(obj->type));
     }
 
     lval* popd = obj->cell[ith];
-    memmove(&obj->cell[ith], &obj->cell[ith + 1], sizeof(lval*) * (obj->count - ith - 1)); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
     obj->count--;
-    obj->cell = realloc(obj->cell, sizeof(lval*) * obj->count);
+
+    // The first element is dropped by advancing past it.
+    if (ith == 0) {
+        obj->cell++;
+        obj->offset++;
+        return popd;
+    }
+
+    memmove(&obj->cell[ith], &obj->cell[ith + 1], sizeof(lval*) * (obj->count - ith)); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
 
     return popd;
 }
 
+lval* lval_slice(lval* obj, unsigned start)
+{
+    lval* owner = obj->owner ? obj->owner : obj;
+    unsigned first = (unsigned)(obj->cell - owner->cell) + start;
+
+    lval* slice = lval_alloc(obj->type);
+    slice->count = obj->count - start;
+    slice->capacity = 0;
+    slice->offset = 0;
+    slice->owner = lval_ref(owner);
+
+    // The owner is copied when a region owner is sliced
+    // from the heap, so the slice views the copy's cells.
+    slice->cell = slice->owner->cell + first;
+
+    lval_del(obj);
+    return slice;
+}
+
 lval* lval_take(lval* obj, unsigned ith)
 {
-    lval* popd = lval_pop(obj, ith);
+    lval* taken = lval_ref(obj->cell[ith]);
     lval_del(obj);
-    return popd;
+    return taken;
+}
+
+void lval_resolve(const lval* formals, lval* body)
+{
+    if (lval_is_fixnum(body)) {
+        return;
+    }
+
+    if (body->type == LVAL_SYM) {
+        // Formals are bound in order, skipping '&' and
+        // rebinding repeated names in their first slot.
+        unsigned slot = 0;
+        body->slot = LVAL_NO_SLOT;
+
+        for (unsigned i = 0; i < formals->count; i++) {
+            const char* sym = formals->cell[i]->sym;
+            int seen = strcmp(sym, "&") == 0;
+
+            for (unsigned j = 0; j < i && !seen; j++) {
+                seen = formals->cell[j]->sym == sym;
+            }
+
+            if (seen) {
+                continue;
+            }
+
+            if (sym == body->sym) {
+                body->slot = slot;
+                return;
+            }
+
+            slot++;
+        }
+
+        return;
+    }
+
+    if (body->type == LVAL_SEXPR || body->type == LVAL_QEXPR) {
+        for (unsigned i = 0; i < body->count; i++) {
+            lval_resolve(formals, body->cell[i]);
+        }
+    }
+}
+
+void lval_set_max_depth(unsigned depth)
+{
+    max_depth = depth;
+}
+
+unsigned lval_max_depth(void)
+{
+    return max_depth;
+}
+
+unsigned lval_depth(void)
+{
+    return eval_depth;
+}
+
+/// Returns how many bytes of native stack evaluations may use.
+static uintptr_t lval_native_limit(void)
+{
+#if defined(__unix__) || defined(__APPLE__)
+    struct rlimit limit;
+
+    if (getrlimit(RLIMIT_STACK, &limit) == 0) {
+        if (limit.rlim_cur == RLIM_INFINITY) {
+            return (uintptr_t)1 << 30;
+        }
+
+        // Leave a quarter for builtins and the C library.
+        return (uintptr_t)limit.rlim_cur / 4 * 3;
+    }
+#endif
+
+    return (uintptr_t)1 << 19;
+}
+
+/// Checks if a nested evaluation is close to exhausting the current stack.
+static int lval_native_low(void)
+{
+    char marker = 0;
+    uintptr_t here = (uintptr_t)&marker;
+
+    if (native_limit == 0) {
+        native_limit = lval_native_limit();
+    }
+
+    uintptr_t used = native_base > here ? native_base - here : here - native_base;
+    return eval_depth && used > native_limit;
+}
+
+#ifdef LVAL_STACK_SEGMENTS
+/// Evaluation to run in a stack segment, and the context to return to.
+typedef struct {
+    lval* (*func)(lenv*, lval*);
+    lenv* env;
+    lval* obj;
+    lval* result;
+    ucontext_t caller;
+} lval_segment;
+
+/// Segment being started, read before it can start another.
+static lval_segment* segment_start = NULL;
+
+static void lval_segment_main(void)
+{
+    lval_segment* seg = segment_start;
+    seg->result = seg->func(seg->env, seg->obj);
+}
+#endif
+
+/// Returns `func(env, obj)` evaluated in a new stack segment,
+/// or NULL if none could be allocated.
+///
+/// The segment is freed once `func` returns, so evaluations
+/// nest as deep as memory and the maximum depth allow.
+static lval* lval_eval_in_segment(lval* (*func)(lenv*, lval*), lenv* env, lval* obj)
+{
+#ifdef LVAL_STACK_SEGMENTS
+    char* stack = malloc(LVAL_SEGMENT_BYTES);
+    lval_segment seg = { .func = func, .env = env, .obj = obj, .result = NULL };
+    ucontext_t context;
+
+    if (stack && getcontext(&context) == 0) {
+        context.uc_stack.ss_sp = stack;
+        context.uc_stack.ss_size = LVAL_SEGMENT_BYTES;
+        context.uc_link = &seg.caller;
+        makecontext(&context, lval_segment_main, 0);
+
+        uintptr_t base = native_base;
+        uintptr_t limit = native_limit;
+        native_base = (uintptr_t)(stack + LVAL_SEGMENT_BYTES);
+        native_limit = LVAL_SEGMENT_BYTES / 4 * 3;
+        segment_start = &seg;
+
+        swapcontext(&seg.caller, &context);
+
+        native_base = base;
+        native_limit = limit;
+    }
+
+    free(stack);
+    return seg.result;
+#else
+    (void)func;
+    (void)env;
+    (void)obj;
+    return NULL;
+#endif
+}
+
+lval* lval_enter(int native)
+{
+    if (eval_depth == 0) {
+        char marker = 0;
+        native_base = (uintptr_t)&marker;
+    }
+
+    if (eval_depth >= max_depth) {
+        return lval_err("Maximum evaluation depth of %u exceeded", max_depth);
+    }
+
+    if (native && lval_native_low()) {
+        return lval_err("Native stack exhausted at evaluation depth %u", eval_depth);
+    }
+
+    eval_depth++;
+    return NULL;
+}
+
+void lval_leave(void)
+{
+    eval_depth--;
 }
 
 lval* lval_eval(lenv* env, lval* obj)
 {
-    if (obj->type == LVAL_SYM) {
+    if (lval_type(obj) == LVAL_SYM) {
         lval* sub = lenv_get(env, obj);
         lval_del(obj);
         return sub;
     }
 
-    if (obj->type == LVAL_SEXPR) {
+    if (lval_type(obj) == LVAL_SEXPR) {
         return lval_eval_sexpr(env, obj);
     }
 
     return obj;
 }
 
-lval* lval_call(lenv* env, lval* func, lval* arg)
+lval* lval_eval_borrowed(lenv* env, lval* obj)
 {
-    if (func->builtin) {
-        return func->builtin(env, arg);
+    if (lval_type(obj) == LVAL_SYM) {
+        return lenv_get(env, obj);
+    }
+
+    if (lval_type(obj) == LVAL_SEXPR) {
+        return lval_eval_body(env, obj);
+    }
+
+    return lval_ref(obj);
+}
+
+/// Checks if `expr`, whose head evaluated to `head`, is `(if c {a} {b})` with literal branches.
+static int lval_is_if(const lval* expr, const lval* head)
+{
+    return expr->count == 4
+        && lval_type(head) == LVAL_FUN && head->builtin == builtin_if
+        && lval_type(expr->cell[2]) == LVAL_QEXPR && lval_type(expr->cell[3]) == LVAL_QEXPR;
+}
+
+/// Checks if the children of `expr` from `first` on are literal clauses `{key expression}`.
+static int lval_is_clauses(const lval* expr, unsigned first)
+{
+    for (unsigned i = first; i < expr->count; i++) {
+        if (lval_type(expr->cell[i]) != LVAL_QEXPR || expr->cell[i]->count < 2) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/// Returns the error `if` reports for the condition `cond`, which is not a number.
+static lval* lval_cond_err(lval* cond)
+{
+    lval* err = lval_type(cond) == LVAL_ERR
+        ? lval_ref(cond)
+        : lval_err("Function '%s' passed incorrect type for argument %i. "
+                   "Got %s, Expected %s.",
+            "if", 0, ltype_name(lval_type(cond)), ltype_name(LVAL_NUM));
+
+    lval_del(cond);
+    return err;
+}
+
+/// Evaluates the special form `expr`, whose head is the builtin `func`, returning NULL
+/// with the expression in tail position in `tail` if it is `do`, or `select` or `case`
+/// with literal clauses, once only that expression is left to evaluate.
+static lval* lval_eval_special(lenv* env, lval* expr, lbuiltin func, lval** tail)
+{
+    if (func == builtin_do) {
+        for (unsigned i = 1; i + 1 < expr->count; i++) {
+            lval* value = lval_eval_borrowed(env, expr->cell[i]);
+
+            if (lval_type(value) == LVAL_ERR) {
+                return value;
+            }
+
+            lval_del(value);
+        }
+
+        *tail = expr->cell[expr->count - 1];
+        return NULL;
+    }
+
+    if (func == builtin_select && lval_is_clauses(expr, 1)) {
+        for (unsigned i = 1; i < expr->count; i++) {
+            lval* cond = lval_eval_borrowed(env, expr->cell[i]->cell[0]);
+
+            if (lval_type(cond) != LVAL_NUM) {
+                return lval_cond_err(cond);
+            }
+
+            int truth = lval_num_value(cond) != 0;
+            lval_del(cond);
+
+            if (truth) {
+                *tail = expr->cell[i]->cell[1];
+                return NULL;
+            }
+        }
+
+        return lval_err("No Selection Found");
+    }
+
+    if (func == builtin_case && expr->count > 2 && lval_is_clauses(expr, 2)) {
+        lval* key = lval_eval_borrowed(env, expr->cell[1]);
+
+        for (unsigned i = 2; i < expr->count && lval_type(key) != LVAL_ERR; i++) {
+            lval* found = lval_eval_borrowed(env, expr->cell[i]->cell[0]);
+
+            if (lval_type(found) == LVAL_ERR) {
+                lval_del(key);
+                return found;
+            }
+
+            int equal = lval_eq(key, found);
+            lval_del(found);
+
+            if (equal) {
+                lval_del(key);
+                *tail = expr->cell[i]->cell[1];
+                return NULL;
+            }
+        }
+
+        if (lval_type(key) == LVAL_ERR) {
+            return key;
+        }
+
+        lval_del(key);
+        return lval_err("No Case Found");
+    }
+
+    // Special forms read their arguments in place, so the
+    // list lives on the same side as `expr` and only
+    // refers to its children instead of copying them into
+    // a region.
+    int heap = !(expr->flags & LALLOC_REGION);
+
+    if (heap) {
+        lalloc_heap_begin();
+    }
+
+    lval* arg = lval_sexpr();
+
+    for (unsigned i = 1; i < expr->count; i++) {
+        lval_add(arg, lval_ref(expr->cell[i]));
+    }
+
+    if (heap) {
+        lalloc_heap_end();
+    }
+
+    return func(env, arg);
+}
+
+static lval* lval_bind(lenv* env, const lval* func, lval* arg, lenv** frame);
+static lval* lval_apply_func(lval* sexpr, lval** func);
+static int lval_is_eval(const lval* sexpr);
+
+/// Applies the evaluated `sexpr` as lval_apply does, except for calls the tree-walker
+/// goes on with in place: `eval` of a Q-Expression, stored in `next`, and a full call
+/// of a lambda without compiled code, stored in `next` with the frame binding its
+/// arguments, whose parent is unset, in `frame`. Those return NULL.
+static lval* lval_apply_tail(lenv* env, lval* sexpr, lval** next, lenv** frame)
+{
+    if (lval_is_eval(sexpr)) {
+        *next = lval_take(sexpr, 1);
+        return NULL;
+    }
+
+    lval* func = NULL;
+    lval* result = lval_apply_func(sexpr, &func);
+
+    if (result) {
+        return result;
+    }
+
+    if (func->builtin || func->code) {
+        result = lval_call(env, func, sexpr);
+        lval_del(func);
+        return result;
+    }
+
+    result = lval_bind(env, func, sexpr, frame);
+
+    if (result) {
+        lval_del(func);
+        return result;
+    }
+
+    *next = func;
+    return NULL;
+}
+
+lval* lval_eval_body(lenv* env, lval* expr)
+{
+    if (lval_native_low()) {
+        lval* result = lval_eval_in_segment(lval_eval_body, env, expr);
+
+        if (result) {
+            return result;
+        }
     }
 
-    unsigned given = arg->count;
-    unsigned total = func->formals->count;
+    lval* err = lval_enter(1);
+
+    if (err) {
+        return err;
+    }
 
-    while (arg->count) {
-        if (func->formals->count == 0) {
-            lval_del(arg);
-            return lval_err("Function passed too many arguments. "
-                            "Got %i, Expected %i. ",
-                given, total);
+    // Tail calls go on in this loop rather than recursing:
+    // `held` keeps the lambda or Q-Expression whose cells
+    // are being evaluated alive, and the innermost `owned`
+    // frames of `env` are those its calls were bound in.
+    lval* result = NULL;
+    lval* held = NULL;
+    unsigned owned = 0;
+
+    while (!result) {
+        // `((f x))` evaluates to whatever `(f x)` does.
+        while (expr->count == 1 && lval_type(expr->cell[0]) == LVAL_SEXPR) {
+            expr = expr->cell[0];
         }
 
-        lval* sym = lval_pop(func->formals, 0);
+        if (expr->count == 0) {
+            result = lval_sexpr();
+            break;
+        }
+
+        lval* head = lval_eval_borrowed(env, expr->cell[0]);
 
-        if (strcmp(sym->sym, "&") == 0) {
-            if (func->formals->count != 1) {
-                lval_del(arg);
+        if (expr->count > 1 && lval_type(head) == LVAL_FUN
+            && head->builtin && builtin_special(head->builtin)) {
+            lval* tail = NULL;
+            result = lval_eval_special(env, expr, head->builtin, &tail);
+            lval_del(head);
 
-                return lval_err("Function format invalid. "
-                                "Symbol '&' not followed by single symbol.");
+            if (tail && lval_type(tail) == LVAL_SEXPR) {
+                expr = tail;
+            } else if (tail) {
+                result = lval_eval_borrowed(env, tail);
             }
 
-            lval* nextsym = lval_pop(func->formals, 0);
-            lenv_put(func->env, nextsym, builtin_list(env, arg));
-            lval_del(sym);
-            lval_del(nextsym);
+            continue;
+        }
+
+        // The taken branch of an `if` is read in place, as
+        // the rest of `expr` is, rather than passed to the
+        // builtin as a value.
+        if (lval_is_if(expr, head)) {
+            lval* cond = lval_eval_borrowed(env, expr->cell[1]);
+            lval_del(head);
+
+            if (lval_type(cond) == LVAL_NUM) {
+                expr = expr->cell[lval_num_value(cond) ? 2 : 3];
+                lval_del(cond);
+                continue;
+            }
+
+            result = lval_cond_err(cond);
             break;
         }
 
-        lval* popd = lval_pop(arg, 0);
-        lenv_put(func->env, sym, popd);
+        lval* sexpr = lval_add(lval_sexpr(), head);
+
+        for (unsigned i = 1; i < expr->count; i++) {
+            lval_add(sexpr, lval_eval_borrowed(env, expr->cell[i]));
+        }
+
+        lval* next = NULL;
+        lenv* frame = NULL;
+        result = lval_apply_tail(env, sexpr, &next, &frame);
+
+        if (result) {
+            break;
+        }
+
+        if (frame) {
+            // A frame the callee shadows completely can never
+            // be looked up again, so the callee replaces it.
+            if (lenv_shadows(frame, env)) {
+                frame->par = env->par;
+
+                if (owned) {
+                    lenv_del(env);
+                    owned--;
+                }
+            } else {
+                frame->par = env;
+            }
+
+            env = frame;
+            owned++;
+            expr = next->body;
+        } else {
+            expr = next;
+        }
+
+        if (held) {
+            lval_del(held);
+        }
+
+        held = next;
+    }
+
+    while (owned--) {
+        lenv* par = env->par;
+        lenv_del(env);
+        env = par;
+    }
+
+    if (held) {
+        lval_del(held);
+    }
+
+    lval_leave();
+
+    return result;
+}
+
+/// Returns the lambda `func` partially applied to `arg`, sharing its formals, body and code.
+static lval* lval_partial(const lval* func, lval* arg)
+{
+    lval* partial = lval_alloc(LVAL_FUN);
+
+    arg->type = LVAL_QEXPR;
+
+    partial->builtin = NULL;
+    partial->bound = func->bound ? lval_join(lval_ref(func->bound), arg) : arg;
+    partial->formals = lval_ref(func->formals);
+    partial->body = lval_ref(func->body);
+    partial->code = func->code ? lvm_code_ref(func->code) : NULL;
+
+    return partial;
+}
+
+/// Binds the arguments the lambda `func` was partially applied to, then `arg`, to
+/// its formals in a new frame, returning NULL with the frame stored in `frame`
+/// once every formal is bound and otherwise the partial application or an error.
+static lval* lval_bind(lenv* env, const lval* func, lval* arg, lenv** frame)
+{
+    static const char* amp = NULL;
+
+    if (!amp) {
+        amp = latom_intern("&");
+    }
+
+    const lval* formals = func->formals;
+    const lval* bound = func->bound;
+    unsigned given = bound ? bound->count : 0;
 
-        lval_del(sym);
+    // `\` only accepts '&' second to last, so the formals
+    // before it are bound in order and the last to the rest.
+    int variadic = formals->count >= 2 && formals->cell[formals->count - 2]->sym == amp;
+    unsigned arity = variadic ? formals->count - 2 : formals->count;
+
+    if (!variadic && given + arg->count > arity) {
+        lval* err = lval_err("Function passed too many arguments. "
+                             "Got %i, Expected %i. ",
+            arg->count, formals->count - given);
+
+        lval_del(arg);
+        return err;
+    }
+
+    if (given + arg->count < arity) {
+        return lval_partial(func, arg);
+    }
+
+    lenv* scope = lenv_new();
+    scope->frame = 1;
+
+    for (unsigned i = 0; i < given; i++) {
+        lenv_put(scope, formals->cell[i], bound->cell[i]);
+    }
+
+    for (unsigned i = given; i < arity; i++) {
+        lval* popd = lval_pop(arg, 0);
+        lenv_put(scope, formals->cell[i], popd);
         lval_del(popd);
     }
 
-    lval_del(arg);
+    if (variadic) {
+        lval* rest = builtin_list(env, arg);
+        lenv_put(scope, formals->cell[arity + 1], rest);
+        lval_del(rest);
+    } else {
+        lval_del(arg);
+    }
 
-    if (func->formals->count > 0 && strcmp(func->formals->cell[0]->sym, "&") == 0) {
+    *frame = scope;
+    return NULL;
+}
 
-        if (func->formals->count != 2) {
-            return lval_err("Function format invalid. "
-                            "Symbol '&' not followed by single symbol.");
-        }
+lval* lval_call(lenv* env, lval* func, lval* arg)
+{
+    if (func->builtin) {
+        return func->builtin(env, arg);
+    }
 
-        lval_del(lval_pop(func->formals, 0));
+    lenv* frame = NULL;
+    lval* partial = lval_bind(env, func, arg, &frame);
 
-        lval* sym = lval_pop(func->formals, 0);
-        lval* val = lval_qexpr();
+    if (partial) {
+        return partial;
+    }
+
+    frame->par = env;
+
+    lval* result = NULL;
 
-        lenv_put(func->env, sym, val);
-        lval_del(sym);
-        lval_del(val);
+    if (func->code) {
+        result = lvm_run_native(func, frame);
+
+        if (!result) {
+            result = lvm_run(frame, func->code);
+        }
+    } else {
+        result = lval_eval_body(frame, func->body);
     }
 
-    if (func->formals->count == 0) {
-        func->env->par = env;
-        return builtin_eval(func->env, lval_add(lval_sexpr(), lval_copy(func->body)));
+    lenv_del(frame);
+    return result;
+}
+
+/// Evaluates the first child of the unshared `sexpr`, returning NULL unless
+/// it is a special form, which is then called with the other children as is.
+static lval* lval_eval_form(lenv* env, lval* sexpr)
+{
+    if (sexpr->count == 0) {
+        return NULL;
+    }
+
+    sexpr->cell[0] = lval_eval(env, sexpr->cell[0]);
+    lval* head = sexpr->cell[0];
+
+    if (sexpr->count == 1 || lval_type(head) != LVAL_FUN
+        || !head->builtin || !builtin_special(head->builtin)) {
+        return NULL;
     }
 
-    return lval_copy(func);
+    head = lval_pop(sexpr, 0);
+    lval* result = head->builtin(env, sexpr);
+    lval_del(head);
+
+    return result;
 }
 
 lval* lval_eval_sexpr(lenv* env, lval* sexpr)
 {
-    for (unsigned i = 0; i < sexpr->count; i++) {
-        sexpr->cell[i] = lval_eval(env, sexpr->cell[i]);
+    if (lval_native_low()) {
+        lval* result = lval_eval_in_segment(lval_eval_sexpr, env, sexpr);
+
+        if (result) {
+            return result;
+        }
     }
 
+    lval* err = lval_enter(1);
+
+    if (err) {
+        lval_del(sexpr);
+        return err;
+    }
+
+    sexpr = lval_unshare(sexpr);
+    lval* result = lval_eval_form(env, sexpr);
+
+    if (!result) {
+        for (unsigned i = 1; i < sexpr->count; i++) {
+            sexpr->cell[i] = lval_eval(env, sexpr->cell[i]);
+        }
+
+        result = lval_apply(env, sexpr);
+    }
+
+    lval_leave();
+
+    return result;
+}
+
+/// Pops the function off the evaluated `sexpr` into `func`, returning NULL,
+/// or returns what `sexpr` evaluates to when it makes no call.
+static lval* lval_apply_func(lval* sexpr, lval** func)
+{
     for (unsigned i = 0; i < sexpr->count; i++) {
-        if (sexpr->cell[i]->type == LVAL_ERR) {
+        if (lval_type(sexpr->cell[i]) == LVAL_ERR) {
             return lval_take(sexpr, i);
         }
     }
@@ -327,28 +1137,130 @@ lval* lval_eval_sexpr(lenv* env, lval* sexpr)
         return lval_take(sexpr, 0);
     }
 
-    lval* func = lval_pop(sexpr, 0);
+    *func = lval_pop(sexpr, 0);
 
-    if (func->type != LVAL_FUN) {
+    if (lval_type(*func) != LVAL_FUN) {
         lval* err = lval_err("S-Expression starts with incorrect type. ",
             "Got %s, Expected %s. ",
-            ltype_name(func->type), ltype_name(LVAL_FUN));
+            ltype_name(lval_type(*func)), ltype_name(LVAL_FUN));
 
-        lval_del(func);
+        lval_del(*func);
         lval_del(sexpr);
         return err;
     }
 
-    lval* result = lval_call(env, func, sexpr);
+    return NULL;
+}
+
+lval* lval_apply(lenv* env, lval* sexpr)
+{
+    lval* func = NULL;
+    lval* result = lval_apply_func(sexpr, &func);
+
+    if (result) {
+        return result;
+    }
+
+    result = lval_call(env, func, sexpr);
     lval_del(func);
 
     return result;
 }
 
+/// Checks if the evaluated `sexpr` calls the builtin `eval` on a Q-Expression.
+static int lval_is_eval(const lval* sexpr)
+{
+    return sexpr->count == 2
+        && lval_type(sexpr->cell[0]) == LVAL_FUN && sexpr->cell[0]->builtin == builtin_eval
+        && lval_type(sexpr->cell[1]) == LVAL_QEXPR;
+}
+
+lval* lval_apply_enter(lenv* env, lval* sexpr, lval** callee, lenv** frame)
+{
+    // Evaluating a Q-Expression is itself a call to the
+    // expression it holds, which is how `select` and
+    // `unpack` reach the expression they run.
+    while (lval_is_eval(sexpr)) {
+        lval* taken = lval_unshare(lval_take(sexpr, 1));
+        taken->type = LVAL_SEXPR;
+
+        // `{(f x)}` evaluates to whatever `(f x)` does.
+        while (taken->count == 1 && lval_type(taken->cell[0]) == LVAL_SEXPR) {
+            taken = lval_unshare(lval_take(taken, 0));
+        }
+
+        lval* result = lval_eval_form(env, taken);
+
+        if (result) {
+            return result;
+        }
+
+        for (unsigned i = 1; i < taken->count; i++) {
+            taken->cell[i] = lval_eval(env, taken->cell[i]);
+        }
+
+        sexpr = taken;
+    }
+
+    lval* func = NULL;
+    lval* result = lval_apply_func(sexpr, &func);
+
+    if (result) {
+        return result;
+    }
+
+    if (func->builtin || !func->code) {
+        result = lval_call(env, func, sexpr);
+        lval_del(func);
+        return result;
+    }
+
+    result = lval_bind(env, func, sexpr, frame);
+
+    if (result) {
+        lval_del(func);
+        return result;
+    }
+
+    *callee = func;
+    return NULL;
+}
+
 lval* lval_join(lval* l_arg, lval* r_arg)
 {
-    while (r_arg->count) {
-        l_arg = lval_add(l_arg, lval_pop(r_arg, 0));
+    // Joining with an empty list shares the other operand.
+    if (r_arg->count == 0) {
+        lval_del(r_arg);
+        return l_arg;
+    }
+
+    if (l_arg->count == 0) {
+        lval_del(l_arg);
+        return r_arg;
+    }
+
+    // Prepending a short l_arg to a longer r_arg that is
+    // not shared only moves l_arg's elements.
+    if (lval_is_unique(r_arg) && !r_arg->owner && r_arg->count > l_arg->count) {
+        lval_reserve(r_arg, l_arg->count, 0);
+
+        r_arg->cell -= l_arg->count;
+        r_arg->offset -= l_arg->count;
+        r_arg->count += l_arg->count;
+
+        for (unsigned i = 0; i < l_arg->count; i++) {
+            r_arg->cell[i] = lval_ref(l_arg->cell[i]);
+        }
+
+        lval_del(l_arg);
+        return r_arg;
+    }
+
+    l_arg = lval_unshare(l_arg);
+    lval_reserve(l_arg, 0, r_arg->count);
+
+    for (unsigned i = 0; i < r_arg->count; i++) {
+        l_arg = lval_add(l_arg, lval_ref(r_arg->cell[i]));
     }
 
     lval_del(r_arg);
@@ -357,19 +1269,19 @@ lval* lval_join(lval* l_arg, lval* r_arg)
 
 int lval_eq(lval* l_arg, lval* r_arg)
 {
-    if (l_arg->type != r_arg->type) {
+    if (lval_type(l_arg) != lval_type(r_arg)) {
         return 0;
     }
 
-    switch (l_arg->type) {
+    switch (lval_type(l_arg)) {
     case LVAL_NUM:
-        return (l_arg->num == r_arg->num);
+        return (lval_num_value(l_arg) == lval_num_value(r_arg));
 
     case LVAL_ERR:
         return (strcmp(l_arg->err, r_arg->err) == 0);
 
     case LVAL_SYM:
-        return (strcmp(l_arg->sym, r_arg->sym) == 0);
+        return (l_arg->sym == r_arg->sym);
 
     case LVAL_STR:
         return (strcmp(l_arg->str, r_arg->str) == 0);
@@ -379,7 +1291,10 @@ int lval_eq(lval* l_arg, lval* r_arg)
             return (l_arg->builtin == r_arg->builtin);
         }
 
-        return (lval_eq(l_arg->formals, r_arg->formals)
+        // Partial applications are compared by the formals
+        // they have left, ignoring the bound values.
+        return ((l_arg->bound ? l_arg->bound->count : 0) == (r_arg->bound ? r_arg->bound->count : 0)
+            && lval_eq(l_arg->formals, r_arg->formals)
             && lval_eq(l_arg->body, r_arg->body));
 
     case LVAL_QEXPR:
@@ -388,6 +1303,12 @@ int lval_eq(lval* l_arg, lval* r_arg)
             return 0;
         }
 
+        // Lists sharing their cells (see lval_slice) are
+        // equal without comparing the elements.
+        if (l_arg->cell == r_arg->cell) {
+            return 1;
+        }
+
         for (unsigned i = 0; i < l_arg->count; ++i) {
             if (!lval_eq(l_arg->cell[i], r_arg->cell[i])) {
                 return 0;
@@ -437,7 +1358,7 @@ lval* load_prelude(lenv* env)
     lval* prelude = lval_add(lval_sexpr(), lval_str(prelude_path));
     lval* prld = builtin_load(env, prelude);
 
-    if (prld->type == LVAL_ERR) {
+    if (lval_type(prld) == LVAL_ERR) {
         lval_println(prld);
     }
 
@@ -0,0 +1,1419 @@
+#include <lvm.h>
+
+#include <builtin.h>
+#include <lalloc.h>
+#include <laot.h>
+#include <latom.h>
+#include <lenv.h>
+#include <ljit.h>
+#include <lval.h>
+#include <utilities.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+/// Dispatch through a table of label addresses where the compiler supports it.
+#if defined(__GNUC__)
+#define LVM_COMPUTED_GOTO 1
+#endif
+
+/// @brief Enum for bytecode opcodes
+///
+/// The possible opcodes are:
+/// - LVM_CONST     : Pushes a new reference to `val`
+/// - LVM_LOOKUP    : Pushes the value bound to the symbol `val`
+/// - LVM_CALL      : Evaluates the top `arg` values as the children of an S-Expression
+/// - LVM_TAIL_CALL : Like LVM_CALL, but enters a compiled lambda in place of the current frame
+/// - LVM_GUARD     : Pops the top value if it is the builtin `form`, otherwise jumps to `arg`
+/// - LVM_CHECK     : Pops the top value and jumps to `arg` unless it is the builtin `form`
+/// - LVM_IF_TEST   : Pops the condition of an inlined `if` and jumps to `arg` if it is false
+/// - LVM_CASE_TEST : Pops a key and, if it equals the key of an inlined `case`, pops that too, otherwise jumps to `arg`
+/// - LVM_STEP      : Pops the value of an expression of `do`, or jumps to `arg` if it is an error
+/// - LVM_AND       : Pops the `aux`th condition of `and`, or jumps to `arg` if it is false
+/// - LVM_OR        : Pops the `aux`th condition of `or`, or jumps to `arg` if it is true
+/// - LVM_EQ        : Pops two values and pushes whether they are equal, or unequal if `aux` is set
+/// - LVM_NTH       : Pops a list and pushes `(head (tail ... list))` with `arg` calls to `tail`
+/// - LVM_BUILTIN   : Pops `arg` values and pushes the first error among them, or else the result of `unchecked`, or `form`, on them
+/// - LVM_DROP      : Pops the top value
+/// - LVM_FAIL      : Pushes the `arg`th error of `lvm_failures`
+/// - LVM_JUMP      : Jumps to `arg`
+/// - LVM_RETURN    : Returns the top value
+enum { LVM_CONST,
+    LVM_LOOKUP,
+    LVM_CALL,
+    LVM_TAIL_CALL,
+    LVM_GUARD,
+    LVM_CHECK,
+    LVM_IF_TEST,
+    LVM_CASE_TEST,
+    LVM_STEP,
+    LVM_AND,
+    LVM_OR,
+    LVM_EQ,
+    LVM_NTH,
+    LVM_BUILTIN,
+    LVM_DROP,
+    LVM_FAIL,
+    LVM_JUMP,
+    LVM_RETURN };
+
+/// @brief Represents a bytecode instruction
+///
+/// A `linst` consists of a:
+/// - op        : unsigned corresponding to the opcode
+/// - arg       : unsigned corresponding to an operand count or the index of a jump target
+/// - aux       : unsigned corresponding to the position of a condition of `and` or `or`
+/// - val       : lval* corresponding to a constant or symbol, borrowed from the compiled body
+/// - form      : lbuiltin corresponding to the builtin a guard or check expects, or LVM_BUILTIN calls
+/// - unchecked : lunchecked corresponding to the entry point LVM_BUILTIN calls on proven numbers (optional)
+typedef struct linst {
+    unsigned op;
+    unsigned arg;
+    unsigned aux;
+    lval* val;
+    lbuiltin form;
+    lunchecked unchecked;
+} linst;
+
+/// @brief Represents a compiled lambda body
+///
+/// A `lcode` consists of a:
+/// - refs      : unsigned corresponding to the number of lambdas sharing the code
+/// - count     : unsigned corresponding to the number of instructions
+/// - capacity  : unsigned corresponding to the length of `insts`
+/// - depth     : unsigned corresponding to the most values the code keeps on the stack
+/// - plain     : unsigned corresponding to the number of fallbacks being compiled, which are not optimized
+/// - calls     : unsigned corresponding to the calls counted towards LVM_HOT_CALLS
+/// - native    : ljit* corresponding to the native code compiled once the code is hot (optional)
+/// - attached  : lnative corresponding to the body compiled ahead of time (optional, see laot.h)
+/// - body      : lval* corresponding to the compiled body, owning every borrowed `val`
+/// - consts    : lval* corresponding to a Q-Expression owning the values folded by the compiler
+/// - insts     : linst* corresponding to the instructions
+struct lcode {
+    unsigned refs;
+    unsigned count;
+    unsigned capacity;
+    unsigned depth;
+    unsigned plain;
+    unsigned calls;
+    ljit* native;
+    lnative attached;
+    lval* body;
+    lval* consts;
+    linst* insts;
+};
+
+/// @brief The value stack shared by every running lcode.
+///
+/// A `lstack` consists of a:
+/// - items     : lval** corresponding to the owned values
+/// - top       : unsigned corresponding to the number of values pushed
+/// - capacity  : unsigned corresponding to the length of `items`
+typedef struct lstack {
+    lval** items;
+    unsigned top;
+    unsigned capacity;
+} lstack;
+
+static lstack stack = { NULL, 0, 0 };
+
+/// @brief The frames of the lambdas entered by running lcode.
+///
+/// A `lscopes` consists of a:
+/// - items     : lenv** corresponding to the owned frames, innermost last
+/// - top       : unsigned corresponding to the number of frames pushed
+/// - capacity  : unsigned corresponding to the length of `items`
+typedef struct lscopes {
+    lenv** items;
+    unsigned top;
+    unsigned capacity;
+} lscopes;
+
+static lscopes scopes = { NULL, 0, 0 };
+
+/// @brief Represents the caller of a running lambda
+///
+/// A `lframe` consists of a:
+/// - code      : const lcode* corresponding to the code of the caller
+/// - ip        : const linst* corresponding to the instruction to resume at
+/// - env       : lenv* corresponding to the environment of the caller
+/// - held      : lval* corresponding to the lambda whose code the caller runs, if the caller owns it
+/// - bottom    : unsigned corresponding to the first of the frames in `scopes` the caller owns
+typedef struct lframe {
+    const lcode* code;
+    const linst* ip;
+    lenv* env;
+    lval* held;
+    unsigned bottom;
+} lframe;
+
+/// @brief The call stack shared by every running lcode.
+///
+/// A `lframes` consists of a:
+/// - items     : lframe* corresponding to the suspended callers
+/// - top       : unsigned corresponding to the number of frames pushed
+/// - capacity  : unsigned corresponding to the length of `items`
+typedef struct lframes {
+    lframe* items;
+    unsigned top;
+    unsigned capacity;
+} lframes;
+
+static lframes frames = { NULL, 0, 0 };
+
+static int enabled = 1;
+
+//////////////////////
+// Configuration
+//////////////////////
+
+void lvm_set_enabled(int enable)
+{
+    enabled = enable;
+}
+
+int lvm_enabled(void)
+{
+    return enabled;
+}
+
+//////////////////////
+// Compilation
+//////////////////////
+
+/// Appends an instruction to `code`, returning its index.
+static unsigned lvm_emit(lcode* code, unsigned op, unsigned arg, lval* val)
+{
+    if (code->count == code->capacity) {
+        code->capacity = code->capacity ? 2 * code->capacity : 16;
+        code->insts = realloc(code->insts, sizeof(linst) * code->capacity);
+
+        if (!code->insts) {
+            exit(1); // NOLINT(concurrency-mt-unsafe)
+        }
+    }
+
+    code->insts[code->count].op = op;
+    code->insts[code->count].arg = arg;
+    code->insts[code->count].aux = 0;
+    code->insts[code->count].val = val;
+    code->insts[code->count].form = NULL;
+    code->insts[code->count].unchecked = NULL;
+
+    return code->count++;
+}
+
+/// Records that the stack grew to `depth` values.
+static void lvm_reach(lcode* code, unsigned depth)
+{
+    code->depth = depth > code->depth ? depth : code->depth;
+}
+
+/// @brief Enum for the special forms compiled inline
+///
+/// Each form is recognised by the symbol at the head of
+/// an S-Expression and guarded by the builtin it names.
+enum { LVM_FORM_IF,
+    LVM_FORM_DO,
+    LVM_FORM_AND,
+    LVM_FORM_OR,
+    LVM_FORM_SELECT,
+    LVM_FORM_CASE,
+    LVM_FORM_NONE };
+
+static const lbuiltin lvm_form_builtins[] = {
+    builtin_if,
+    builtin_do,
+    builtin_and,
+    builtin_or,
+    builtin_select,
+    builtin_case,
+};
+
+/// Errors pushed by LVM_FAIL.
+static const char* const lvm_failures[] = {
+    "No Selection Found",
+    "No Case Found",
+};
+
+/// Checks if the children of `sexpr` from `first` on are literal clauses `{x y}`.
+static int lvm_is_clauses(const lval* sexpr, unsigned first)
+{
+    for (unsigned i = first; i < sexpr->count; i++) {
+        if (lval_type(sexpr->cell[i]) != LVAL_QEXPR || sexpr->cell[i]->count < 2) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/// Returns the special form `sexpr` can be compiled inline as, or LVM_FORM_NONE.
+static int lvm_form(const lval* sexpr)
+{
+    static const char* names[LVM_FORM_NONE] = { NULL };
+
+    if (names[0] == NULL) {
+        names[LVM_FORM_IF] = latom_intern("if");
+        names[LVM_FORM_DO] = latom_intern("do");
+        names[LVM_FORM_AND] = latom_intern("and");
+        names[LVM_FORM_OR] = latom_intern("or");
+        names[LVM_FORM_SELECT] = latom_intern("select");
+        names[LVM_FORM_CASE] = latom_intern("case");
+    }
+
+    if (sexpr->count < 2 || lval_type(sexpr->cell[0]) != LVAL_SYM) {
+        return LVM_FORM_NONE;
+    }
+
+    int form = 0;
+
+    while (form < LVM_FORM_NONE && sexpr->cell[0]->sym != names[form]) {
+        form++;
+    }
+
+    switch (form) {
+    case LVM_FORM_IF:
+        return sexpr->count == 4
+                && lval_type(sexpr->cell[2]) == LVAL_QEXPR
+                && lval_type(sexpr->cell[3]) == LVAL_QEXPR
+            ? form
+            : LVM_FORM_NONE;
+
+    case LVM_FORM_SELECT:
+        return lvm_is_clauses(sexpr, 1) ? form : LVM_FORM_NONE;
+
+    case LVM_FORM_CASE:
+        return sexpr->count > 2 && lvm_is_clauses(sexpr, 2) ? form : LVM_FORM_NONE;
+
+    default:
+        return form;
+    }
+}
+
+/// Emits `op` jumping to the end of the form being compiled, chaining it onto `exits`.
+static unsigned lvm_emit_exit(lcode* code, unsigned op, unsigned* exits)
+{
+    unsigned idx = lvm_emit(code, op, *exits, NULL);
+    *exits = idx + 1;
+    return idx;
+}
+
+/// Points every jump chained onto `exits` at the next instruction.
+static void lvm_patch_exits(lcode* code, unsigned exits)
+{
+    while (exits) {
+        unsigned idx = exits - 1;
+        exits = code->insts[idx].arg;
+        code->insts[idx].arg = code->count;
+    }
+}
+
+/// Builtins without side effects, whose calls the compiler optimizes.
+static struct {
+    const char* name;
+    lbuiltin func;
+} lvm_pures[] = {
+    { "+", builtin_add },
+    { "-", builtin_sub },
+    { "*", builtin_mul },
+    { "/", builtin_div },
+    { "==", builtin_eq },
+    { "!=", builtin_ne },
+    { ">", builtin_gt },
+    { "<", builtin_lt },
+    { ">=", builtin_ge },
+    { "<=", builtin_le },
+    { "head", builtin_head },
+    { "tail", builtin_tail },
+};
+
+/// Returns the pure builtin the symbol `obj` names by default, or NULL.
+static lbuiltin lvm_pure(const lval* obj)
+{
+    static int interned = 0;
+    unsigned count = sizeof(lvm_pures) / sizeof(lvm_pures[0]);
+
+    if (!interned) {
+        for (unsigned i = 0; i < count; i++) {
+            lvm_pures[i].name = latom_intern(lvm_pures[i].name);
+        }
+
+        interned = 1;
+    }
+
+    if (lval_type(obj) != LVAL_SYM) {
+        return NULL;
+    }
+
+    for (unsigned i = 0; i < count; i++) {
+        if (obj->sym == lvm_pures[i].name) {
+            return lvm_pures[i].func;
+        }
+    }
+
+    return NULL;
+}
+
+static lval* lvm_fold(lval* obj);
+
+/// Returns the value of `sexpr` evaluated as a call of a pure builtin on constants, or NULL.
+///
+/// Calls that fail are not folded so the error is still
+/// raised, and reported, when the body runs.
+static lval* lvm_fold_call(const lval* sexpr)
+{
+    lbuiltin func = sexpr->count > 1 ? lvm_pure(sexpr->cell[0]) : NULL;
+
+    if (!func) {
+        return NULL;
+    }
+
+    lval* arg = lval_sexpr();
+
+    for (unsigned i = 1; i < sexpr->count; i++) {
+        lval* value = lvm_fold(sexpr->cell[i]);
+
+        if (!value) {
+            lval_del(arg);
+            return NULL;
+        }
+
+        lval_add(arg, value);
+    }
+
+    lval* result = func(NULL, arg);
+
+    if (lval_type(result) == LVAL_ERR) {
+        lval_del(result);
+        return NULL;
+    }
+
+    return result;
+}
+
+/// Returns the value of `obj` if it is a constant or a folded call, or NULL.
+static lval* lvm_fold(lval* obj)
+{
+    switch (lval_type(obj)) {
+    case LVAL_SYM:
+        return NULL;
+
+    case LVAL_SEXPR:
+        return lvm_fold_call(obj);
+
+    default:
+        return lval_ref(obj);
+    }
+}
+
+/// Emits a check that the symbol `obj` still names its pure builtin, chaining it onto `fails`.
+static void lvm_emit_check(lcode* code, unsigned depth, lval* obj, unsigned* fails)
+{
+    lvm_emit(code, LVM_LOOKUP, 0, obj);
+    lvm_reach(code, depth + 1);
+
+    unsigned check = lvm_emit_exit(code, LVM_CHECK, fails);
+    code->insts[check].form = lvm_pure(obj);
+}
+
+/// Emits checks for the head of the folded call `sexpr` and of every call nested in it.
+static void lvm_emit_checks(lcode* code, unsigned depth, const lval* sexpr, unsigned* fails)
+{
+    lvm_emit_check(code, depth, sexpr->cell[0], fails);
+
+    for (unsigned i = 1; i < sexpr->count; i++) {
+        if (lval_type(sexpr->cell[i]) == LVAL_SEXPR) {
+            lvm_emit_checks(code, depth, sexpr->cell[i], fails);
+        }
+    }
+}
+
+/// Checks if `obj` calls the pure builtin `func` with a single argument.
+static int lvm_is_unary(const lval* obj, lbuiltin func)
+{
+    return lval_type(obj) == LVAL_SEXPR && obj->count == 2 && lvm_pure(obj->cell[0]) == func;
+}
+
+/// Checks if evaluating `obj` only looks up symbols and calls pure builtins, so it has no side effects.
+static int lvm_is_pure(const lval* obj)
+{
+    if (lval_type(obj) != LVAL_SEXPR) {
+        return 1;
+    }
+
+    if (obj->count < 2 || !lvm_pure(obj->cell[0])) {
+        return 0;
+    }
+
+    for (unsigned i = 1; i < obj->count; i++) {
+        if (!lvm_is_pure(obj->cell[i])) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/// Checks if `obj` is proven to evaluate to a number or an error.
+///
+/// Numbers are, and so are pure calls of the arithmetic
+/// and comparison builtins once checks show their heads
+/// still name them. Pure calls cannot redefine a builtin
+/// between those checks and the calls they prove.
+static int lvm_proves_num(const lval* obj)
+{
+    if (lval_type(obj) == LVAL_NUM) {
+        return 1;
+    }
+
+    if (lval_type(obj) != LVAL_SEXPR || !lvm_is_pure(obj)) {
+        return 0;
+    }
+
+    lbuiltin func = lvm_pure(obj->cell[0]);
+    return func != builtin_head && func != builtin_tail;
+}
+
+/// Checks if every argument of `sexpr` is proven to evaluate to a number or an error.
+static int lvm_proves_args(const lval* sexpr)
+{
+    for (unsigned i = 1; i < sexpr->count; i++) {
+        if (!lvm_proves_num(sexpr->cell[i])) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static void lvm_compile_expr(lcode* code, unsigned depth, lval* obj, int tail);
+static void lvm_compile_call(lcode* code, unsigned depth, const lval* sexpr, int tail);
+
+/// Compiles the pure call `sexpr`, whose heads are checked to name their builtins, to call them directly.
+///
+/// Calls whose arguments are proven to be numbers use the
+/// entry point of their builtin without argument checks.
+static void lvm_compile_builtins(lcode* code, unsigned depth, const lval* sexpr)
+{
+    lunchecked unchecked = lvm_proves_args(sexpr) ? builtin_unchecked(lvm_pure(sexpr->cell[0]), sexpr->count - 1) : NULL;
+
+    for (unsigned i = 1; i < sexpr->count; i++) {
+        lval* arg = sexpr->cell[i];
+        lval* folded = lval_type(arg) == LVAL_SEXPR ? lvm_fold_call(arg) : NULL;
+
+        if (folded) {
+            lval_add(code->consts, folded);
+            lvm_emit(code, LVM_CONST, 0, folded);
+            lvm_reach(code, depth + i);
+        } else if (lval_type(arg) == LVAL_SEXPR) {
+            lvm_compile_builtins(code, depth + i - 1, arg);
+        } else {
+            lvm_compile_expr(code, depth + i - 1, arg, 0);
+        }
+    }
+
+    unsigned call = lvm_emit(code, LVM_BUILTIN, sexpr->count - 1, NULL);
+    code->insts[call].form = lvm_pure(sexpr->cell[0]);
+    code->insts[call].unchecked = unchecked;
+}
+
+/// Compiles a call of pure builtins optimized, returning 0 if there is no optimization for `sexpr`.
+///
+/// A call on constants is folded into its value, a chain
+/// `(head (tail (tail l)))` becomes one LVM_NTH and `==`
+/// or `!=` compare their arguments without a call. Other
+/// arithmetic and ordering on arguments proven to be
+/// numbers, such as `(+ (* x x) 1)`, skip the argument
+/// checks of the builtin through LVM_BUILTIN. The
+/// optimized code runs behind checks that the heads still
+/// name those builtins, so redefining or shadowing one
+/// falls back to the call itself.
+static int lvm_compile_pure(lcode* code, unsigned depth, const lval* sexpr, int tail)
+{
+    lbuiltin func = sexpr->count > 1 ? lvm_pure(sexpr->cell[0]) : NULL;
+
+    if (!func || code->plain) {
+        return 0;
+    }
+
+    unsigned fails = 0;
+    lval* folded = lvm_fold_call(sexpr);
+
+    if (folded) {
+        lvm_emit_checks(code, depth, sexpr, &fails);
+        lval_add(code->consts, folded);
+        lvm_emit(code, LVM_CONST, 0, folded);
+    } else if (func == builtin_head && sexpr->count == 2) {
+        unsigned tails = 0;
+        lval* list = sexpr->cell[1];
+
+        lvm_emit_check(code, depth, sexpr->cell[0], &fails);
+
+        while (lvm_is_unary(list, builtin_tail)) {
+            lvm_emit_check(code, depth, list->cell[0], &fails);
+            list = list->cell[1];
+            tails++;
+        }
+
+        lvm_compile_expr(code, depth, list, 0);
+        lvm_emit(code, LVM_NTH, tails, NULL);
+    } else if ((func == builtin_eq || func == builtin_ne) && sexpr->count == 3) {
+        lvm_emit_check(code, depth, sexpr->cell[0], &fails);
+        lvm_compile_expr(code, depth, sexpr->cell[1], 0);
+        lvm_compile_expr(code, depth + 1, sexpr->cell[2], 0);
+
+        unsigned compare = lvm_emit(code, LVM_EQ, 0, NULL);
+        code->insts[compare].aux = func == builtin_ne;
+    } else if (builtin_unchecked(func, sexpr->count - 1) && lvm_proves_args(sexpr)) {
+        lvm_emit_checks(code, depth, sexpr, &fails);
+        lvm_compile_builtins(code, depth, sexpr);
+    } else {
+        return 0;
+    }
+
+    lvm_reach(code, depth + 1);
+
+    unsigned exits = 0;
+    lvm_emit_exit(code, LVM_JUMP, &exits);
+    lvm_patch_exits(code, fails);
+
+    // The fallback only runs once a builtin is redefined,
+    // so it is compiled as is to keep the code linear in
+    // the size of the body.
+    code->plain++;
+    lvm_compile_call(code, depth, sexpr, tail);
+    code->plain--;
+
+    lvm_patch_exits(code, exits);
+    return 1;
+}
+
+static void lvm_compile_sexpr(lcode* code, unsigned depth, const lval* sexpr, int tail);
+
+/// Compiles `obj` to push its value onto a stack holding `depth` values.
+static void lvm_compile_expr(lcode* code, unsigned depth, lval* obj, int tail)
+{
+    switch (lval_type(obj)) {
+    case LVAL_SYM:
+        lvm_emit(code, LVM_LOOKUP, 0, obj);
+        lvm_reach(code, depth + 1);
+        break;
+
+    case LVAL_SEXPR:
+        lvm_compile_sexpr(code, depth, obj, tail);
+        break;
+
+    default:
+        lvm_emit(code, LVM_CONST, 0, obj);
+        lvm_reach(code, depth + 1);
+        break;
+    }
+}
+
+/// Compiles the inlined body of the special form `form`.
+///
+/// `(if c {a} {b})` tests the condition without building
+/// the argument list and runs the taken branch in place.
+/// A condition that is not a number leaves an error which
+/// LVM_IF_TEST reports by jumping to the instruction
+/// before its target, the jump ending the first branch.
+/// `select` tests its clauses the same way and `case`
+/// keeps its key on the stack while comparing it. `do`,
+/// `and` and `or` leave through LVM_STEP, LVM_AND and
+/// LVM_OR as soon as their value is known. The branch or
+/// expression evaluated last is in tail position when the
+/// form is.
+static void lvm_compile_inline(lcode* code, unsigned depth, const lval* sexpr, int tail, int form, unsigned* exits)
+{
+    switch (form) {
+    case LVM_FORM_IF: {
+        lvm_compile_expr(code, depth, sexpr->cell[1], 0);
+        unsigned test = lvm_emit(code, LVM_IF_TEST, 0, NULL);
+
+        lvm_compile_sexpr(code, depth, sexpr->cell[2], tail);
+        lvm_emit_exit(code, LVM_JUMP, exits);
+
+        code->insts[test].arg = code->count;
+        lvm_compile_sexpr(code, depth, sexpr->cell[3], tail);
+        break;
+    }
+
+    case LVM_FORM_DO:
+        for (unsigned i = 1; i + 1 < sexpr->count; i++) {
+            lvm_compile_expr(code, depth, sexpr->cell[i], 0);
+            lvm_emit_exit(code, LVM_STEP, exits);
+        }
+
+        lvm_compile_expr(code, depth, sexpr->cell[sexpr->count - 1], tail);
+        break;
+
+    case LVM_FORM_AND:
+    case LVM_FORM_OR:
+        for (unsigned i = 1; i < sexpr->count; i++) {
+            lvm_compile_expr(code, depth, sexpr->cell[i], 0);
+            unsigned test = lvm_emit_exit(code, form == LVM_FORM_AND ? LVM_AND : LVM_OR, exits);
+            code->insts[test].aux = i - 1;
+        }
+
+        lvm_emit(code, LVM_CONST, 0, lval_num(form == LVM_FORM_AND));
+        break;
+
+    case LVM_FORM_SELECT:
+        for (unsigned i = 1; i < sexpr->count; i++) {
+            lvm_compile_expr(code, depth, sexpr->cell[i]->cell[0], 0);
+            unsigned test = lvm_emit(code, LVM_IF_TEST, 0, NULL);
+
+            lvm_compile_expr(code, depth, sexpr->cell[i]->cell[1], tail);
+            lvm_emit_exit(code, LVM_JUMP, exits);
+            code->insts[test].arg = code->count;
+        }
+
+        lvm_emit(code, LVM_FAIL, 0, NULL);
+        break;
+
+    case LVM_FORM_CASE:
+        lvm_compile_expr(code, depth, sexpr->cell[1], 0);
+
+        for (unsigned i = 2; i < sexpr->count; i++) {
+            lvm_compile_expr(code, depth + 1, sexpr->cell[i]->cell[0], 0);
+            unsigned test = lvm_emit(code, LVM_CASE_TEST, 0, NULL);
+
+            lvm_compile_expr(code, depth, sexpr->cell[i]->cell[1], tail);
+            lvm_emit_exit(code, LVM_JUMP, exits);
+            code->insts[test].arg = code->count;
+        }
+
+        lvm_emit(code, LVM_DROP, 0, NULL);
+        lvm_emit(code, LVM_FAIL, 1, NULL);
+        break;
+
+    default:
+        break;
+    }
+}
+
+/// Compiles the special form `form` inline behind a guard.
+///
+/// If the head no longer names the builtin the form is
+/// evaluated as a call, with its arguments evaluated.
+static void lvm_compile_form(lcode* code, unsigned depth, const lval* sexpr, int tail, int form)
+{
+    unsigned exits = 0;
+
+    lvm_compile_expr(code, depth, sexpr->cell[0], 0);
+    unsigned guard = lvm_emit(code, LVM_GUARD, 0, NULL);
+    code->insts[guard].form = lvm_form_builtins[form];
+
+    lvm_compile_inline(code, depth, sexpr, tail, form, &exits);
+    lvm_emit_exit(code, LVM_JUMP, &exits);
+
+    // The guard left the head on the stack.
+    code->insts[guard].arg = code->count;
+
+    for (unsigned i = 1; i < sexpr->count; i++) {
+        lvm_compile_expr(code, depth + i, sexpr->cell[i], 0);
+    }
+
+    lvm_emit(code, tail ? LVM_TAIL_CALL : LVM_CALL, sexpr->count, NULL);
+    lvm_reach(code, depth + 1);
+    lvm_patch_exits(code, exits);
+}
+
+/// Compiles `sexpr` as a call of its head with the rest of its children.
+static void lvm_compile_call(lcode* code, unsigned depth, const lval* sexpr, int tail)
+{
+    for (unsigned i = 0; i < sexpr->count; i++) {
+        lvm_compile_expr(code, depth + i, sexpr->cell[i], 0);
+    }
+
+    lvm_emit(code, tail ? LVM_TAIL_CALL : LVM_CALL, sexpr->count, NULL);
+    lvm_reach(code, depth + 1);
+}
+
+/// Compiles the children of `sexpr` as an S-Expression, whose value is returned if `tail` is set.
+static void lvm_compile_sexpr(lcode* code, unsigned depth, const lval* sexpr, int tail)
+{
+    int form = lvm_form(sexpr);
+
+    if (form != LVM_FORM_NONE) {
+        lvm_compile_form(code, depth, sexpr, tail, form);
+        return;
+    }
+
+    if (!lvm_compile_pure(code, depth, sexpr, tail)) {
+        lvm_compile_call(code, depth, sexpr, tail);
+    }
+}
+
+lcode* lvm_compile(lval* body)
+{
+    lcode* code = malloc(sizeof(lcode));
+
+    if (!code) {
+        exit(1); // NOLINT(concurrency-mt-unsafe)
+    }
+
+    code->refs = 1;
+    code->count = 0;
+    code->capacity = 0;
+    code->depth = 0;
+    code->plain = 0;
+    code->calls = 0;
+    code->native = NULL;
+    code->attached = NULL;
+    code->insts = NULL;
+
+    // Code outlives any region, so it borrows from a body
+    // on the heap and keeps its constants there.
+    lalloc_heap_begin();
+    code->body = lval_ref(body);
+    code->consts = lval_qexpr();
+
+    lvm_compile_sexpr(code, 0, code->body, 1);
+    lvm_emit(code, LVM_RETURN, 0, NULL);
+    lalloc_heap_end();
+
+    return code;
+}
+
+void lvm_attach(lcode* code, lnative func)
+{
+    code->attached = func;
+}
+
+lnative lvm_attached(const lcode* code)
+{
+    return code->attached;
+}
+
+lcode* lvm_code_ref(lcode* code)
+{
+    code->refs++;
+    return code;
+}
+
+void lvm_code_del(lcode* code)
+{
+    if (--code->refs > 0) {
+        return;
+    }
+
+    if (code->native) {
+        ljit_del(code->native);
+    }
+
+    lval_del(code->body);
+    lval_del(code->consts);
+    free(code->insts);
+    free(code);
+}
+
+//////////////////////
+// Execution
+//////////////////////
+
+int lvm_count_call(const lval* func)
+{
+    lcode* code = func->code;
+
+    if (code->calls < LVM_HOT_CALLS) {
+        if (++code->calls == LVM_HOT_CALLS) {
+            code->native = ljit_compile(func->formals, code->body);
+        }
+
+        return 0;
+    }
+
+    return code->native != NULL;
+}
+
+lval* lvm_run_native(const lval* func, lenv* frame)
+{
+    lcode* code = func->code;
+    lval* result = NULL;
+
+    if (lvm_count_call(func)) {
+        result = ljit_run(code->native, frame);
+    }
+
+    if (result || !code->attached) {
+        return result;
+    }
+
+    // Attached bodies recurse on the C stack, so past their
+    // share of it the VM runs the code instead.
+    if (!laot_begin()) {
+        return NULL;
+    }
+
+    result = code->attached(frame);
+    laot_end();
+
+    return result;
+}
+
+/// Makes room for `count` more values on the stack.
+static void lvm_reserve(unsigned count)
+{
+    if (stack.top + count <= stack.capacity) {
+        return;
+    }
+
+    unsigned capacity = stack.capacity ? stack.capacity : 256;
+
+    while (capacity < stack.top + count) {
+        capacity *= 2;
+    }
+
+    stack.items = realloc(stack.items, sizeof(lval*) * capacity);
+
+    if (!stack.items) {
+        exit(1); // NOLINT(concurrency-mt-unsafe)
+    }
+
+    stack.capacity = capacity;
+}
+
+/// Pushes a frame resuming at `ip`, returning it.
+static lframe* lvm_push_frame(const linst* ip)
+{
+    if (frames.top == frames.capacity) {
+        frames.capacity = frames.capacity ? 2 * frames.capacity : 64;
+        frames.items = realloc(frames.items, sizeof(lframe) * frames.capacity);
+
+        if (!frames.items) {
+            exit(1); // NOLINT(concurrency-mt-unsafe)
+        }
+    }
+
+    lframe* frame = frames.items + frames.top++;
+    frame->ip = ip;
+
+    return frame;
+}
+
+/// Pushes `scope` onto the frames owned by the running lambdas.
+static void lvm_push_scope(lenv* scope)
+{
+    if (scopes.top == scopes.capacity) {
+        scopes.capacity = scopes.capacity ? 2 * scopes.capacity : 64;
+        scopes.items = realloc(scopes.items, sizeof(lenv*) * scopes.capacity);
+
+        if (!scopes.items) {
+            exit(1); // NOLINT(concurrency-mt-unsafe)
+        }
+    }
+
+    scopes.items[scopes.top++] = scope;
+}
+
+/// Pops the top `count` values into an S-Expression.
+static lval* lvm_sexpr(unsigned count)
+{
+    lval* sexpr = lval_sexpr();
+    stack.top -= count;
+
+    if (count) {
+        sexpr->count = count;
+        sexpr->capacity = count;
+        sexpr->cell = lalloc_cells(count);
+        memcpy(sexpr->cell, stack.items + stack.top, sizeof(lval*) * count); // NOLINT(clang-analyzer-security.insecureAPI.DeprecatedOrUnsafeBufferHandling)
+    }
+
+    return sexpr;
+}
+
+/// Pops the condition of an inlined `if`, returning -1 and pushing an error if it is not a number.
+static int lvm_test(void)
+{
+    lval* cond = stack.items[--stack.top];
+
+    if (lval_type(cond) == LVAL_NUM) {
+        int truth = lval_num_value(cond) != 0;
+        lval_del(cond);
+        return truth;
+    }
+
+    if (lval_type(cond) != LVAL_ERR) {
+        lval* err = lval_err("Function '%s' passed incorrect type for argument %i. "
+                             "Got %s, Expected %s.",
+            "if", 0, ltype_name(lval_type(cond)), ltype_name(LVAL_NUM));
+
+        lval_del(cond);
+        cond = err;
+    }
+
+    stack.items[stack.top++] = cond;
+    return -1;
+}
+
+/// Tests the `ith` condition of `and` or `or`, named by `func`, returning 1
+/// and leaving the result if it is an error or `stop`, and otherwise popping it.
+static int lvm_logic(const char* func, unsigned ith, int stop)
+{
+    lval* cond = stack.items[stack.top - 1];
+
+    if (lval_type(cond) == LVAL_NUM && (lval_num_value(cond) != 0) != stop) {
+        lval_del(cond);
+        stack.top--;
+        return 0;
+    }
+
+    if (lval_type(cond) == LVAL_ERR) {
+        return 1;
+    }
+
+    lval* result = lval_type(cond) == LVAL_NUM
+        ? lval_num(stop)
+        : lval_err("Function '%s' passed incorrect type for argument %i. "
+                   "Got %s, Expected %s.",
+            func, ith, ltype_name(lval_type(cond)), ltype_name(LVAL_NUM));
+
+    lval_del(cond);
+    stack.items[stack.top - 1] = result;
+    return 1;
+}
+
+/// Compares `lhs` and `rhs` like `==`, or `!=` if `negate` is set, returning the first if either is an error.
+static lval* lvm_compare(lval* lhs, lval* rhs, int negate)
+{
+    if (lval_type(lhs) == LVAL_ERR) {
+        lval_del(rhs);
+        return lhs;
+    }
+
+    if (lval_type(rhs) == LVAL_ERR) {
+        lval_del(lhs);
+        return rhs;
+    }
+
+    int equal = lval_eq(lhs, rhs);
+
+    lval_del(lhs);
+    lval_del(rhs);
+
+    return lval_num(equal != negate);
+}
+
+/// Returns `(head (tail ... list))` with `tails` calls to `tail`.
+static lval* lvm_nth(lenv* env, lval* list, unsigned tails)
+{
+    if (lval_type(list) == LVAL_QEXPR && list->count > tails) {
+        lval* head = lval_add(lval_qexpr(), lval_ref(list->cell[tails]));
+        lval_del(list);
+        return head;
+    }
+
+    // Makes the calls one at a time so that the error is
+    // the one the first failing call reports.
+    for (unsigned i = 0; i < tails && lval_type(list) != LVAL_ERR; i++) {
+        list = builtin_tail(env, lval_add(lval_sexpr(), list));
+    }
+
+    if (lval_type(list) == LVAL_ERR) {
+        return list;
+    }
+
+    return builtin_head(env, lval_add(lval_sexpr(), list));
+}
+
+/// Pops the top `count` values and calls the builtin of `inst` on them.
+///
+/// As for any call, the first error is the result.
+static lval* lvm_builtin(lenv* env, const linst* inst, unsigned count)
+{
+    lval** args = stack.items + stack.top - count;
+
+    for (unsigned i = 0; i < count; i++) {
+        if (lval_type(args[i]) == LVAL_ERR) {
+            lval* err = args[i];
+
+            for (unsigned j = 0; j < count; j++) {
+                if (j != i) {
+                    lval_del(args[j]);
+                }
+            }
+
+            stack.top -= count;
+            return err;
+        }
+    }
+
+    if (!inst->unchecked) {
+        return inst->form(env, lvm_sexpr(count));
+    }
+
+    lval* result = inst->unchecked(args, count);
+
+    for (unsigned i = 0; i < count; i++) {
+        lval_del(args[i]);
+    }
+
+    stack.top -= count;
+    return result;
+}
+
+#if defined(LVM_COMPUTED_GOTO)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#define LVM_OP(name) op_##name:
+#define LVM_NEXT goto* labels[ip->op]
+#else
+#define LVM_OP(name) case name:
+#define LVM_NEXT break
+#endif
+
+lval* lvm_run(lenv* env, const lcode* code)
+{
+    lval* err = lval_enter(1);
+
+    if (err) {
+        return err;
+    }
+
+    lvm_reserve(code->depth);
+
+    const linst* ip = code->insts;
+
+    // Calls between compiled lambdas push a frame rather
+    // than recursing, so frames below `entry` belong to an
+    // outer run.
+    unsigned entry = frames.top;
+
+    // Lambdas entered by a call are owned by this run: the
+    // current one is `held`, and its frame and those still
+    // reachable from it after a tail call are the frames
+    // in `scopes` from `bottom` on. Frames below `bottom`
+    // belong to callers, as does `env` when none is owned.
+    unsigned bottom = scopes.top;
+    lval* held = NULL;
+
+#if defined(LVM_COMPUTED_GOTO)
+    static void* const labels[] = {
+        &&op_LVM_CONST,
+        &&op_LVM_LOOKUP,
+        &&op_LVM_CALL,
+        &&op_LVM_TAIL_CALL,
+        &&op_LVM_GUARD,
+        &&op_LVM_CHECK,
+        &&op_LVM_IF_TEST,
+        &&op_LVM_CASE_TEST,
+        &&op_LVM_STEP,
+        &&op_LVM_AND,
+        &&op_LVM_OR,
+        &&op_LVM_EQ,
+        &&op_LVM_NTH,
+        &&op_LVM_BUILTIN,
+        &&op_LVM_DROP,
+        &&op_LVM_FAIL,
+        &&op_LVM_JUMP,
+        &&op_LVM_RETURN,
+    };
+
+    LVM_NEXT;
+#else
+    for (;;) {
+        switch (ip->op) {
+#endif
+
+    LVM_OP(LVM_CONST)
+    {
+        stack.items[stack.top++] = lval_ref(ip->val);
+        ip++;
+        LVM_NEXT;
+    }
+
+    LVM_OP(LVM_LOOKUP)
+    {
+        stack.items[stack.top++] = lenv_get(env, ip->val);
+        ip++;
+        LVM_NEXT;
+    }
+
+    LVM_OP(LVM_CALL)
+    {
+        // Calls may run other code and grow the stack, so
+        // the result is stored only once they return.
+        lval* callee = NULL;
+        lenv* scope = NULL;
+        lval* result = lval_apply_enter(env, lvm_sexpr(ip->arg), &callee, &scope);
+
+        if (!result) {
+            scope->par = env;
+            result = lvm_run_native(callee, scope);
+
+            if (result) {
+                lenv_del(scope);
+                lval_del(callee);
+            }
+        }
+
+        if (!result) {
+            result = lval_enter(0);
+
+            if (result) {
+                lenv_del(scope);
+                lval_del(callee);
+            }
+        }
+
+        if (result) {
+            stack.items[stack.top++] = result;
+            ip++;
+            LVM_NEXT;
+        }
+
+        lframe* frame = lvm_push_frame(ip + 1);
+        frame->code = code;
+        frame->env = env;
+        frame->held = held;
+        frame->bottom = bottom;
+
+        scope->par = env;
+        bottom = scopes.top;
+        lvm_push_scope(scope);
+
+        held = callee;
+        env = scope;
+        code = callee->code;
+
+        lvm_reserve(code->depth);
+        ip = code->insts;
+        LVM_NEXT;
+    }
+
+    LVM_OP(LVM_TAIL_CALL)
+    {
+        lval* callee = NULL;
+        lenv* scope = NULL;
+        lval* result = lval_apply_enter(env, lvm_sexpr(ip->arg), &callee, &scope);
+
+        if (!result) {
+            scope->par = env;
+            result = lvm_run_native(callee, scope);
+
+            if (result) {
+                lenv_del(scope);
+                lval_del(callee);
+            }
+        }
+
+        if (result) {
+            stack.items[stack.top++] = result;
+            ip++;
+            LVM_NEXT;
+        }
+
+        // A frame the callee shadows completely can never be
+        // looked up again, so the callee replaces it.
+        if (lenv_shadows(scope, env)) {
+            scope->par = env->par;
+
+            if (scopes.top > bottom) {
+                lenv_del(scopes.items[--scopes.top]);
+            }
+        } else {
+            scope->par = env;
+        }
+
+        lvm_push_scope(scope);
+
+        if (held) {
+            lval_del(held);
+        }
+
+        held = callee;
+        env = scope;
+        code = callee->code;
+
+        lvm_reserve(code->depth);
+        ip = code->insts;
+        LVM_NEXT;
+    }
+
+    LVM_OP(LVM_GUARD)
+    {
+        lval* top = stack.items[stack.top - 1];
+
+        if (lval_type(top) != LVAL_FUN || top->builtin != ip->form) {
+            ip = code->insts + ip->arg;
+            LVM_NEXT;
+        }
+
+        lval_del(top);
+        stack.top--;
+        ip++;
+        LVM_NEXT;
+    }
+
+    LVM_OP(LVM_CHECK)
+    {
+        lval* top = stack.items[--stack.top];
+        int named = lval_type(top) == LVAL_FUN && top->builtin == ip->form;
+
+        lval_del(top);
+        ip = named ? ip + 1 : code->insts + ip->arg;
+        LVM_NEXT;
+    }
+
+    LVM_OP(LVM_IF_TEST)
+    {
+        int truth = lvm_test();
+
+        if (truth < 0) {
+            ip = code->insts + ip->arg - 1;
+        } else if (truth == 0) {
+            ip = code->insts + ip->arg;
+        } else {
+            ip++;
+        }
+
+        LVM_NEXT;
+    }
+
+    LVM_OP(LVM_CASE_TEST)
+    {
+        lval* found = stack.items[--stack.top];
+        lval* key = stack.items[stack.top - 1];
+
+        // An error in either key ends the `case` with it,
+        // leaving through the jump ending the last clause.
+        if (lval_type(found) == LVAL_ERR) {
+            lval_del(key);
+            stack.items[stack.top - 1] = found;
+            ip = code->insts + ip->arg - 1;
+        } else if (lval_type(key) == LVAL_ERR) {
+            lval_del(found);
+            ip = code->insts + ip->arg - 1;
+        } else if (lval_eq(key, found)) {
+            lval_del(found);
+            lval_del(key);
+            stack.top--;
+            ip++;
+        } else {
+            lval_del(found);
+            ip = code->insts + ip->arg;
+        }
+
+        LVM_NEXT;
+    }
+
+    LVM_OP(LVM_STEP)
+    {
+        lval* top = stack.items[stack.top - 1];
+
+        if (lval_type(top) == LVAL_ERR) {
+            ip = code->insts + ip->arg;
+            LVM_NEXT;
+        }
+
+        lval_del(top);
+        stack.top--;
+        ip++;
+        LVM_NEXT;
+    }
+
+    LVM_OP(LVM_AND)
+    {
+        if (lvm_logic("and", ip->aux, 0)) {
+            ip = code->insts + ip->arg;
+        } else {
+            ip++;
+        }
+
+        LVM_NEXT;
+    }
+
+    LVM_OP(LVM_OR)
+    {
+        if (lvm_logic("or", ip->aux, 1)) {
+            ip = code->insts + ip->arg;
+        } else {
+            ip++;
+        }
+
+        LVM_NEXT;
+    }
+
+    LVM_OP(LVM_EQ)
+    {
+        lval* rhs = stack.items[--stack.top];
+        stack.items[stack.top - 1] = lvm_compare(stack.items[stack.top - 1], rhs, (int)ip->aux);
+        ip++;
+        LVM_NEXT;
+    }
+
+    LVM_OP(LVM_NTH)
+    {
+        stack.items[stack.top - 1] = lvm_nth(env, stack.items[stack.top - 1], ip->arg);
+        ip++;
+        LVM_NEXT;
+    }
+
+    LVM_OP(LVM_BUILTIN)
+    {
+        lval* result = lvm_builtin(env, ip, ip->arg);
+        stack.items[stack.top++] = result;
+        ip++;
+        LVM_NEXT;
+    }
+
+    LVM_OP(LVM_DROP)
+    {
+        lval_del(stack.items[--stack.top]);
+        ip++;
+        LVM_NEXT;
+    }
+
+    LVM_OP(LVM_FAIL)
+    {
+        stack.items[stack.top++] = lval_err(lvm_failures[ip->arg]);
+        ip++;
+        LVM_NEXT;
+    }
+
+    LVM_OP(LVM_JUMP)
+    {
+        ip = code->insts + ip->arg;
+        LVM_NEXT;
+    }
+
+    LVM_OP(LVM_RETURN)
+    {
+        lval* result = stack.items[--stack.top];
+
+        if (held) {
+            lval_del(held);
+        }
+
+        while (scopes.top > bottom) {
+            lenv_del(scopes.items[--scopes.top]);
+        }
+
+        if (frames.top == entry) {
+            lval_leave();
+            return result;
+        }
+
+        const lframe* frame = frames.items + --frames.top;
+        code = frame->code;
+        ip = frame->ip;
+        env = frame->env;
+        held = frame->held;
+        bottom = frame->bottom;
+
+        lval_leave();
+        stack.items[stack.top++] = result;
+        LVM_NEXT;
+    }
+
+#if !defined(LVM_COMPUTED_GOTO)
+        }
+    }
+#endif
+}
+
+#if defined(LVM_COMPUTED_GOTO)
+#pragma GCC diagnostic pop
+#endif
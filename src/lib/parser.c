@@ -10,7 +10,7 @@ lval* lval_read_expr(const char* str, int* idx, char end)
     while (str[*idx] != end) {
         lval* rval = lval_read(str, idx);
 
-        if (rval->type == LVAL_ERR) {
+        if (lval_type(rval) == LVAL_ERR) {
             lval_del(rexpr);
             return rval;
         }
@@ -121,53 +121,40 @@ lval* lval_read_str(const char* str, int* idx)
 
 lval* lval_read_sym(const char* str, int* idx)
 {
-    char* part = calloc(1, 1);
+    const char* part = &str[*idx];
+    size_t len = 0;
 
     while (strchr(
                "abcdefghijklmnopqrstuvwxyz"
                "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
                "0123456789_+-*\\/=<>!&",
-               str[*idx])
-        && str[*idx] != '\0') {
-        char* old_part = part;
-        part = realloc(part, strlen(part) + 2);
-
-        if (!part) {
-            free(old_part);
-            exit(1); // NOLINT(concurrency-mt-unsafe)
-        }
-
-        part[strlen(part) + 1] = '\0';
-        part[strlen(part) + 0] = str[*idx];
-        (*idx)++;
+               part[len])
+        && part[len] != '\0') {
+        len++;
     }
 
+    *idx += (int)len;
+
     int is_num = strchr("-0123456789", part[0]) != NULL;
 
-    for (size_t j = 1; j < strlen(part); j++) {
+    for (size_t j = 1; j < len; j++) {
         if (strchr("0123456789", part[j]) == NULL) {
             is_num = 0;
             break;
         }
     }
 
-    if (strlen(part) == 1 && part[0] == '-') {
+    if (len == 1 && part[0] == '-') {
         is_num = 0;
     }
 
-    lval* rexpr = NULL;
-
     if (is_num) {
         errno = 0;
         long num = strtol(part, NULL, 10); // NOLINT(readability-magic-numbers)
-        rexpr = (errno != ERANGE) ? lval_num(num) : lval_err("Invalid Number %s", part);
-    } else {
-        rexpr = lval_sym(part);
+        return (errno != ERANGE) ? lval_num(num) : lval_err("Invalid Number %.*s", (int)len, part);
     }
 
-    free(part);
-
-    return rexpr;
+    return lval_sym_n(part, len);
 }
 
 char lval_str_unescape(char chr)
@@ -1,5 +1,10 @@
+#include <catch2/catch_message.hpp>
 #include <catch2/catch_test_macros.hpp>
 
+#include <cstddef>
+#include <initializer_list>
+#include <string>
+
 extern "C" {
     #include <lispy.h>
 
@@ -9,6 +14,216 @@ extern "C" {
     #include <stdlib.h>
 }
 
+namespace {
+
+/// Which evaluators new lambdas and environments use.
+struct lispy_config {
+    int vm;
+    int jit;
+    int native;
+};
+
+const lispy_config tree_walker = { 0, 0, 1 };
+const lispy_config bytecode = { 1, 0, 1 };
+const lispy_config native_code = { 1, 1, 1 };
+const lispy_config lispy_prelude = { 1, 1, 0 };
+
+/// Sets the evaluators of `config`, restoring the
+/// defaults when it goes out of scope.
+struct lispy_modes {
+    explicit lispy_modes(const lispy_config& config)
+    {
+        lvm_set_enabled(config.vm);
+        ljit_set_enabled(config.jit);
+        lenv_set_native_prelude(config.native);
+    }
+
+    ~lispy_modes()
+    {
+        lvm_set_enabled(1);
+        ljit_set_enabled(1);
+        lenv_set_native_prelude(1);
+    }
+};
+
+/// Evaluates each expression of `src` in a fresh environment
+/// holding the builtins and the prelude, returning the value
+/// of the last one.
+lval* lispy_run(const char* src)
+{
+    lenv* env = lenv_new();
+    lenv_add_builtins(env);
+    lval_del(builtin_load(env, lval_add(lval_sexpr(), lval_str(LISPY_PRELUDE_PATH))));
+
+    int pos = 0;
+    lval* exprs = lval_read_expr(src, &pos, '\0');
+    lval* result = lval_sexpr();
+
+    while (lval_type(exprs) != LVAL_ERR && exprs->count) {
+        lval_del(result);
+        result = lval_eval(env, lval_pop(exprs, 0));
+    }
+
+    if (lval_type(exprs) == LVAL_ERR) {
+        lval_del(result);
+        result = lval_ref(exprs);
+    }
+
+    lval_del(exprs);
+    lenv_del(env);
+    return result;
+}
+
+/// Runs `src` with lispy_run under the evaluators of `config`.
+lval* lispy_run_with(const lispy_config& config, const char* src)
+{
+    lispy_modes modes(config);
+    return lispy_run(src);
+}
+
+/// Parses `src` as a single expression, without evaluating it.
+lval* lispy_parse(const char* src)
+{
+    int pos = 0;
+    return lval_take(lval_read_expr(src, &pos, '\0'), 0);
+}
+
+/// Checks if `src` evaluates to the expression `expected`.
+bool lispy_evaluates_to(const char* src, const char* expected)
+{
+    lval* result = lispy_run(src);
+    lval* value = lispy_parse(expected);
+    bool same = lval_eq(result, value);
+
+    lval_del(result);
+    lval_del(value);
+    return same;
+}
+
+/// Checks if `src` evaluates to an error reading `message`.
+bool lispy_fails_with(const char* src, const char* message)
+{
+    lval* result = lispy_run(src);
+    lval* err = lval_err("%s", message);
+    bool same = lval_eq(result, err);
+
+    lval_del(result);
+    lval_del(err);
+    return same;
+}
+
+/// Checks that each of `programs` evaluates to the same value under `lhs` and `rhs`.
+template <std::size_t N>
+void lispy_check_agreement(const char* const (&programs)[N], const lispy_config& lhs, const lispy_config& rhs)
+{
+    for (const char* src : programs) {
+        INFO(src);
+
+        lval* expected = lispy_run_with(lhs, src);
+        lval* actual = lispy_run_with(rhs, src);
+        CHECK(lval_eq(expected, actual));
+
+        lval_del(expected);
+        lval_del(actual);
+    }
+}
+
+/// Programs whose value must not depend on how lambdas are evaluated.
+const char* const corpus[] = {
+    "(+ 1 (* 2 3) (- 10 4) (/ 9 3))",
+    "(if (> 3 2) {1} {2})",
+    "(fun {fact n} {if (== n 0) {1} {* n (fact (- n 1))}}) (fact 20)",
+    "(fun {fib n} {if (< n 2) {n} {+ (fib (- n 1)) (fib (- n 2))}}) (fib 20)",
+    "(fun {count n acc} {if (== n 0) {acc} {count (- n 1) (+ acc 1)}}) (count 50000 0)",
+    "(fun {even n} {if (== n 0) {1} {odd (- n 1)}}) (fun {odd n} {if (== n 0) {0} {even (- n 1)}}) (even 20001)",
+    "(def {add} (\\ {x y} {+ x y})) (def {inc} (add 1)) (map inc {1 2 3})",
+    "(fun {args x & rest} {join (list x) rest}) (args 1 2 3)",
+    "(fun {classify n} {select {(< n 0) \"neg\"} {(== n 0) \"zero\"} {otherwise \"pos\"}}) (map classify {-1 0 1})",
+    "(fun {name n} {case n {0 \"zero\"} {1 \"one\"}}) (list (name 0) (name 1))",
+    "(fun {name n} {case n {0 \"zero\"}}) (name 5)",
+    "(fun {f x} {do (= {y} (* x 2)) (+ y 1)}) (f 4)",
+    "(let {do (= {x} 3) (* x x)})",
+    "(fun {both a b} {and (> a 0) (> b 0)}) (list (both 1 2) (both 1 -2) (or 0 0 1))",
+    "(foldl + 0 (filter (\\ {x} {> x 2}) {1 2 3 4 5}))",
+    "(reverse (take 3 (drop 2 {1 2 3 4 5 6 7})))",
+    "(fun {sum-to n} {loop {i acc} 0 0 {if (> i n) {acc} {recur (+ i 1) (+ acc i)}}}) (sum-to 1000)",
+    "(def {n} 0) (while {< n 100} {= {n} (+ n 3)}) n",
+    "(def {s} 0) (for-range {i} 0 10 2 {= {s} (+ s i)}) s",
+    "(fun {f x} {/ 10 x}) (f 0)",
+    "(fun {f x} {+ x undefined-name}) (f 1)",
+    "(fun {f x} {+ x {1}}) (f 1)",
+    "(fun {f x} {if x {1} {2}}) (f {})",
+    "(fun {f x} {head x}) (f {})",
+    "(fun {f x y} {+ x y}) (f 1 2 3)",
+    "(fun {g x} {* x 2}) (fun {f x} {g (+ x 1)}) (def {g} (\\ {x} {- x 2})) (f 5)",
+    "(def {+} -) (fun {f x} {+ x 1}) (f 5)",
+    "(fun {f x} {eval (list + x x)}) (f 21)",
+    "(fun {f xs} {if (== xs {}) {0} {+ (head xs) (f (tail xs))}}) (f {1 2 3 4 5 6 7 8 9 10})",
+    "(fun {f x} {\\ {y} {+ x y}}) ((f 1) 2)",
+    "(fun {compose2 f g x} {f (g x)}) (compose2 (\\ {x} {* x x}) (\\ {x} {+ x 1}) 4)",
+    "(fun {f n} {if (== n 0) {\"done\"} {f (- n 1)}}) (f 100000)",
+};
+
+/// Programs over the prelude functions that have native builtins.
+const char* const prelude_corpus[] = {
+    "(list (len {}) (len {1 2 3}))",
+    "(list (nth 0 {1 2 3}) (nth 2 {1 2 3}))",
+    "(last {1 2 3})",
+    "(list (reverse {}) (reverse {1 2 3}))",
+    "(list (take 0 {1 2}) (take 2 {1 2 3}) (take 5 {1 2}))",
+    "(list (drop 0 {1 2}) (drop 2 {1 2 3}) (drop 5 {1 2}))",
+    "(map (\\ {x} {* x x}) {1 2 3})",
+    "(map (\\ {x} {* x x}) {})",
+    "(filter (\\ {x} {> x 1}) {1 2 3})",
+    "(foldl - 0 {1 2 3})",
+    "(foldr - 0 {1 2 3})",
+    "(list (sum {1 2 3 4}) (product {1 2 3 4}) (sum {}) (product {}))",
+    "(list (min 3 1 2) (max 3 1 2) (min 5) (max 5))",
+    "(zip {1 2 3} {4 5 6})",
+    "(lookup \"b\" {{\"a\" 1} {\"b\" 2}})",
+    "(do (= {x} 3) (* x 2))",
+    "(let {do (= {x} 4) (+ x 1)})",
+    "(select {(== 1 2) 1} {(== 1 1) 2} {otherwise 3})",
+    "(case 2 {1 \"one\"} {2 \"two\"})",
+    "(list (and 1 1) (and 1 0) (and 2 3) (or 0 1) (or 0 0) (or 0 5))",
+    "(fun {f x} {sum (map (\\ {y} {* y x}) {1 2 3})}) (f 2)",
+};
+
+/// Programs calling lambdas often enough to run them as native code.
+const char* const jit_corpus[] = {
+    "(fun {f x} {* x x}) (fun {g n acc} {if (== n 0) {acc} {g (- n 1) (+ acc (f n))}}) (g 1000 0)",
+    "(fun {f x} {+ x 4611686018427387800}) (fun {g n} {if (== n 0) {{}} {join (list (f n)) (g (- n 1))}}) (g 200)",
+    "(fun {f x} {* x 2}) (fun {g n} {if (== n 0) {{}} {join (list (f (+ n 2305843009213693900))) (g (- n 1))}}) (g 200)",
+    "(fun {f x} {- x 1}) (fun {g n} {if (== n 4611686018427387800) {0} {+ 1 (g (f n))}}) (g 4611686018427388100)",
+    "(fun {f x y} {/ x y}) (fun {g n} {if (== n 0) {{}} {join (list (f n 3)) (g (- n 1))}}) (g 200)",
+    "(fun {f x y} {/ x y}) (fun {g n} {if (== n 0) {0} {+ (f n 1) (g (- n 1))}}) (g 200) (f 1 0)",
+    "(fun {f x} {if (< x 0) {- x} {x}}) (fun {g n} {if (== n 0) {{}} {join (list (f (- n 100))) (g (- n 1))}}) (g 200)",
+    "(fun {f x} {+ x 1}) (fun {g n} {if (== n 0) {0} {+ (f n) (g (- n 1))}}) (g 200) (f {1})",
+    "(fun {f x} {+ x 1}) (fun {g n} {if (== n 0) {0} {+ (f n) (g (- n 1))}}) (g 200) (f \"one\")",
+    "(fun {f x} {+ x 1}) (fun {g n} {if (== n 0) {0} {+ (f n) (g (- n 1))}}) (g 200) (def {+} -) (list (f 5) (g 10))",
+    "(def {k} 10) (fun {f x} {* x k}) (fun {g n} {if (== n 0) {0} {+ (f n) (g (- n 1))}}) (g 200) (def {k} 2) (g 10)",
+    "(fun {fib n} {if (< n 2) {n} {+ (fib (- n 1)) (fib (- n 2))}}) (fib 22)",
+    "(fun {sum n} {if (== n 0) {0} {+ n (sum (- n 1))}}) (list (sum 200) (sum 20000))",
+};
+
+/// Programs whose builtin calls have arguments the VM proves are numbers.
+const char* const unchecked_corpus[] = {
+    "(fun {f x} {+ (* x x) 1}) (list (f 3) (f -4))",
+    "(fun {f x y} {- (* x y) (+ x y) (/ x y)}) (f 12 4)",
+    "(fun {f x} {- (* x 2)}) (f 21)",
+    "(fun {f x} {list (> (* x 2) 10) (< (+ x 1) 3) (>= (- x 1) 4) (<= (* x x) 25)}) (list (f 5) (f 1))",
+    "(fun {f x} {+ (* x x) 1}) (f {1})",
+    "(fun {f x} {+ (/ x 0) 1}) (f 5)",
+    "(fun {f x} {* (+ x 1) (/ 10 x)}) (f 0)",
+    "(fun {f x} {< (+ x 1) (- x 1)}) (f \"one\")",
+    "(fun {f x} {+ (* x x) 1}) (def {*} -) (f 3)",
+    "(fun {f x} {+ (* x x) 1}) (def {+} list) (f 3)",
+    "(fun {f + x} {+ (* x x) 1}) (f - 3)",
+    "(fun {f x} {+ (* x 4611686018427387) 1}) (f 1000)",
+};
+
+} // namespace
+
 TEST_CASE("Lispy Test", "[library]")
 {
     lenv* denv = lenv_new();
@@ -67,3 +282,411 @@ TEST_CASE("Lispy Test", "[library]")
     lval_del(pre);
     lenv_del(denv);
 }
+
+TEST_CASE("The VM agrees with the tree-walker", "[vm]")
+{
+    lispy_check_agreement(corpus, tree_walker, bytecode);
+    lispy_check_agreement(corpus, tree_walker, native_code);
+}
+
+TEST_CASE("The VM evaluates lambdas", "[vm]")
+{
+    CHECK(lispy_evaluates_to("(fun {fib n} {if (< n 2) {n} {+ (fib (- n 1)) (fib (- n 2))}}) (fib 20)", "6765"));
+    CHECK(lispy_evaluates_to("(fun {count n acc} {if (== n 0) {acc} {count (- n 1) (+ acc 1)}}) (count 50000 0)", "50000"));
+    CHECK(lispy_evaluates_to("(def {inc} ((\\ {x y} {+ x y}) 1)) (map inc {1 2 3})", "{2 3 4}"));
+    CHECK(lispy_fails_with("(fun {f x} {/ 10 x}) (f 0)", "Division by zero!"));
+}
+
+TEST_CASE("The native prelude agrees with the Lispy prelude", "[prelude]")
+{
+    lispy_check_agreement(prelude_corpus, native_code, lispy_prelude);
+}
+
+TEST_CASE("Only the Lispy prelude sees the functions it calls redefined", "[prelude]")
+{
+    const char* const last = "(def {-} +) (last {1 2 3})";
+    const char* const sum = "(def {+} -) (sum {1 2 3})";
+    const char* const map = "(def {head} tail) (map (\\ {x} {x}) {1 2})";
+
+    {
+        lispy_modes modes(native_code);
+        CHECK(lispy_evaluates_to(last, "3"));
+        CHECK(lispy_evaluates_to(sum, "6"));
+        CHECK(lispy_evaluates_to(map, "{1 2}"));
+    }
+
+    lispy_modes modes(lispy_prelude);
+    CHECK(lispy_fails_with(last, "Function 'tail' passed {} for argument 0."));
+    CHECK(lispy_evaluates_to(sum, "-6"));
+    CHECK(lispy_evaluates_to(map, "{2 ()}"));
+}
+
+TEST_CASE("Loops rebind their symbols on recur", "[loop]")
+{
+    CHECK(lispy_evaluates_to("(loop {i acc} 0 0 {if (> i 10) {acc} {recur (+ i 1) (+ acc i)}})", "55"));
+    CHECK(lispy_evaluates_to("(loop {i} 0 {select {(< i 3) (recur (+ i 1))} {otherwise i}})", "3"));
+    CHECK(lispy_evaluates_to("(loop {i} 0 {case i {5 \"five\"} {0 (recur 5)}})", "\"five\""));
+    CHECK(lispy_evaluates_to("(loop {i} 0 {if (< i 3) {do (+ 1 1) (recur (+ i 1))} {i}})", "3"));
+    CHECK(lispy_evaluates_to("(loop {i} 0 {if (< i 3) {eval {recur (+ i 1)}} {i}})", "3"));
+    CHECK(lispy_evaluates_to("(loop {i} 0 {if (< i 3) {recur (+ i 1)} {loop {j} i {if (< j 6) {recur (+ j 1)} {list i j}}}})", "{3 6}"));
+    CHECK(lispy_evaluates_to("(fun {f n} {loop {i} 0 {if (< i n) {recur (+ i 1)} {i}}}) (f 100000)", "100000"));
+}
+
+TEST_CASE("Loops reject a misplaced recur", "[loop]")
+{
+    CHECK(lispy_fails_with("(loop {i} 0 {if (< i 5) {+ 100 (recur (+ i 1))} {i}})",
+        "Function 'recur' called outside of tail position of 'loop'."));
+    CHECK(lispy_fails_with("(loop {i} 0 {if (< i 3) {recur (+ i 1) 2} {i}})",
+        "Function 'recur' passed incorrect number of arguments. Got 2, Expected 1."));
+    CHECK(lispy_fails_with("(loop {i acc} 0 {i})",
+        "Function 'loop' passed incorrect number of values for symbols. Got 1, Expected 2."));
+    CHECK(lispy_fails_with("(recur 1)", "Function 'recur' called outside of 'loop'"));
+    CHECK(lispy_fails_with("(fun {f x} {recur x}) (f 1)", "Function 'recur' called outside of 'loop'"));
+}
+
+TEST_CASE("recur only signals the loop it appears in", "[loop]")
+{
+    const char* const message = "Function 'recur' called outside of tail position of 'loop'.";
+
+    for (const lispy_config& config : { tree_walker, bytecode, native_code, lispy_prelude }) {
+        lispy_modes modes(config);
+        CAPTURE(config.vm, config.jit, config.native);
+
+        CHECK(lispy_fails_with("(fun {k n} {recur n}) (loop {i} 0 {if (< i 3) {k (+ i 1)} {i}})", message));
+        CHECK(lispy_fails_with("(fun {k n} {recur n}) (loop {i} 0 {if (< i 3) {list (k (+ i 1))} {i}})", message));
+        CHECK(lispy_fails_with("(fun {k n} {recur n}) (loop {i} 0 {do (def {zz} (k 5)) (if (< i 3) {recur (+ i 1)} {i})})", message));
+        CHECK(lispy_fails_with("(fun {k n} {recur n}) (loop {i} 0 {do (def {zz} (k 5)) 1}) zz", "Unbound symbol 'zz'"));
+        CHECK(lispy_fails_with("(loop {i} 0 {if (< i 3) {eval (list recur (+ i 1))} {i}})", message));
+        CHECK(lispy_evaluates_to("(loop {i} 0 {case i {3 i} {2 (do (recur 3))} {1 (eval {recur 2})} {0 (select {1 (recur 1)})}})", "3"));
+    }
+}
+
+TEST_CASE("for-range and while run their bodies", "[loop]")
+{
+    CHECK(lispy_evaluates_to("(def {s} {}) (for-range {i} 0 5 {def {s} (join s (list i))}) s", "{0 1 2 3 4}"));
+    CHECK(lispy_evaluates_to("(def {s} {}) (for-range {i} 5 0 -2 {def {s} (join s (list i))}) s", "{5 3 1}"));
+    CHECK(lispy_evaluates_to("(for-range {i} 0 3 {* i 10})", "20"));
+    CHECK(lispy_evaluates_to("(for-range {i} 3 0 {i})", "{}"));
+    CHECK(lispy_fails_with("(for-range {i} 0 10 0 {i})", "Function 'for-range' passed a step of zero."));
+    CHECK(lispy_evaluates_to("(def {n} 0) (while {< n 100} {= {n} (+ n 3)}) n", "102"));
+}
+
+TEST_CASE("Folded builtin calls follow their heads", "[vm]")
+{
+    CHECK(lispy_evaluates_to("(fun {f x} {+ x (* (+ 1 2) (- 10 4))}) (f 1)", "19"));
+    CHECK(lispy_evaluates_to("(fun {f x} {+ x (* 2 3)}) (def {*} +) (f 1)", "6"));
+    CHECK(lispy_evaluates_to("(fun {f + x} {+ x (* 2 3)}) (f - 1)", "-5"));
+    CHECK(lispy_evaluates_to("(fun {f l} {head (tail (tail l))}) (f {1 2 3 4})", "{3}"));
+    CHECK(lispy_evaluates_to("(fun {f l} {head (tail (tail l))}) (def {tail} (\\ {l} {l})) (f {1 2 3 4})", "{1}"));
+    CHECK(lispy_evaluates_to("(fun {f x} {list (== x Nil) (!= x Nil)}) (list (f {}) (f 1))", "{{1 0} {0 1}}"));
+    CHECK(lispy_evaluates_to("(fun {f x} {== x Nil}) (def {==} !=) (f {})", "0"));
+    CHECK(lispy_fails_with("(fun {f x} {+ x (/ 1 0)}) (f 1)", "Division by zero!"));
+    CHECK(lispy_fails_with("(fun {f l} {head (tail l)}) (f {1})", "Function 'head' passed {} for argument 0."));
+}
+
+TEST_CASE("Recursion is bounded by the maximum depth, not the native stack", "[eval]")
+{
+    const char* const deep = "(fun {sum n} {if (== n 0) {0} {+ n (sum (- n 1))}}) (sum 200000)";
+
+    for (const lispy_config& config : { tree_walker, bytecode, native_code }) {
+        lispy_modes modes(config);
+        CAPTURE(config.vm, config.jit);
+
+        CHECK(lispy_evaluates_to(deep, "20000100000"));
+
+        lval_set_max_depth(1000);
+        CHECK(lispy_fails_with(deep, "Maximum evaluation depth of 1000 exceeded"));
+        CHECK(lispy_evaluates_to("(fun {sum n} {if (== n 0) {0} {+ n (sum (- n 1))}}) (sum 10)", "55"));
+        lval_set_max_depth(LVAL_MAX_DEPTH);
+    }
+}
+
+TEST_CASE("Native code agrees with the VM", "[jit]")
+{
+    lispy_check_agreement(jit_corpus, bytecode, native_code);
+}
+
+#if defined(__x86_64__) && defined(__linux__)
+TEST_CASE("Native code stops after LJIT_MAX_DEOPTS deoptimizations", "[jit]")
+{
+    lenv* env = lenv_new();
+    lenv_add_builtins(env);
+
+    lval* formals = lispy_parse("{x y}");
+    lval* body = lispy_parse("{/ x y}");
+    ljit* jit = ljit_compile(formals, body);
+    REQUIRE(jit);
+
+    lenv* frame = lenv_new();
+    frame->frame = 1;
+    frame->par = env;
+    lenv_put(frame, formals->cell[0], lval_num(12));
+    lenv_put(frame, formals->cell[1], lval_num(4));
+
+    lval* result = ljit_run(jit, frame);
+    CHECK(lval_num_value(result) == 3);
+    lval_del(result);
+
+    // The arguments are checked before the code runs, so
+    // rejecting them does not count as a deoptimization.
+    lval* list = lispy_parse("{4}");
+    lenv_put(frame, formals->cell[1], list);
+    lval_del(list);
+
+    for (unsigned i = 0; i < 2 * LJIT_MAX_DEOPTS; i++) {
+        CHECK_FALSE(ljit_run(jit, frame));
+    }
+
+    lenv_put(frame, formals->cell[1], lval_num(4));
+    result = ljit_run(jit, frame);
+    CHECK(lval_num_value(result) == 3);
+    lval_del(result);
+
+    lenv_put(frame, formals->cell[1], lval_num(0));
+
+    for (unsigned i = 0; i < LJIT_MAX_DEOPTS; i++) {
+        CHECK_FALSE(ljit_run(jit, frame));
+    }
+
+    lenv_put(frame, formals->cell[1], lval_num(4));
+    CHECK_FALSE(ljit_run(jit, frame));
+
+    lenv_del(frame);
+    ljit_del(jit);
+    lval_del(body);
+    lval_del(formals);
+    lenv_del(env);
+}
+#endif
+
+TEST_CASE("Unchecked builtins agree with the checked builtins", "[builtin]")
+{
+    const struct {
+        lbuiltin checked;
+        unsigned count;
+        long lhs; // NOLINT(google-runtime-int)
+        long rhs; // NOLINT(google-runtime-int)
+    } calls[] = {
+        { builtin_add, 2, 40, 2 },
+        { builtin_sub, 2, 40, 2 },
+        { builtin_sub, 1, 40, 0 },
+        { builtin_mul, 2, -6, 7 },
+        { builtin_div, 2, 85, 2 },
+        { builtin_div, 2, 85, 0 },
+        { builtin_gt, 2, 3, 2 },
+        { builtin_lt, 2, 3, 2 },
+        { builtin_ge, 2, 2, 2 },
+        { builtin_le, 2, 3, 2 },
+    };
+
+    for (const auto& call : calls) {
+        lunchecked unchecked = builtin_unchecked(call.checked, call.count);
+        REQUIRE(unchecked);
+
+        lval* args[] = { lval_num(call.lhs), lval_num(call.rhs) };
+        lval* arg = lval_sexpr();
+
+        for (unsigned i = 0; i < call.count; i++) {
+            lval_add(arg, lval_ref(args[i]));
+        }
+
+        lval* expected = call.checked(NULL, arg);
+        lval* result = unchecked(args, call.count);
+        CHECK(lval_eq(expected, result));
+
+        lval_del(expected);
+        lval_del(result);
+        lval_del(args[0]);
+        lval_del(args[1]);
+    }
+
+    CHECK(builtin_unchecked(builtin_add, 3));
+    CHECK_FALSE(builtin_unchecked(builtin_add, 0));
+    CHECK_FALSE(builtin_unchecked(builtin_lt, 3));
+    CHECK_FALSE(builtin_unchecked(builtin_eq, 2));
+    CHECK_FALSE(builtin_unchecked(builtin_head, 1));
+}
+
+TEST_CASE("The VM skips argument checks only when they cannot fail", "[vm]")
+{
+    lispy_check_agreement(unchecked_corpus, tree_walker, bytecode);
+}
+
+TEST_CASE("The allocator counts what it hands out", "[alloc]")
+{
+    lalloc_stats before = lalloc_get_stats();
+
+    lval* list = lval_qexpr();
+
+    for (unsigned i = 0; i < 100; i++) {
+        lval_add(list, lval_str("pooled"));
+    }
+
+    lalloc_stats during = lalloc_get_stats();
+    CHECK(during.bytes_in_use > before.bytes_in_use);
+
+#ifndef LISPY_SYSTEM_ALLOC
+    CHECK(during.live_lvals == before.live_lvals + 101);
+    CHECK(during.slabs >= 1);
+#endif
+
+    lval_del(list);
+
+    lalloc_stats after = lalloc_get_stats();
+    CHECK(after.bytes_in_use == before.bytes_in_use);
+
+#ifndef LISPY_SYSTEM_ALLOC
+    CHECK(after.live_lvals == before.live_lvals);
+    CHECK(after.free_lvals == during.free_lvals + 101);
+    CHECK(after.slabs == during.slabs);
+#endif
+}
+
+TEST_CASE("Definitions outlive the region of their expression", "[alloc]")
+{
+    lenv* env = lenv_new();
+    lenv_add_builtins(env);
+    lval_del(builtin_load(env, lval_add(lval_sexpr(), lval_str(LISPY_PRELUDE_PATH))));
+
+    lval* expected = lispy_parse("{1 4 9 16}");
+    lalloc_set_region_mode(1);
+
+    const char* const forms[] = {
+        "(def {xs} (map (\\ {x} {* x x}) {1 2 3}))",
+        "(fun {extend l} {join l (list (* 4 4))})",
+        "(def {ys} (extend xs))",
+        "(extend xs)",
+    };
+
+    for (const char* src : forms) {
+        INFO(src);
+
+        lalloc_region_begin();
+#ifndef LISPY_SYSTEM_ALLOC
+        CHECK(lalloc_region_active());
+#endif
+
+        lval* result = lval_eval(env, lispy_parse(src));
+        CHECK(lval_type(result) != LVAL_ERR);
+        lval_del(result);
+
+        lalloc_region_end();
+        CHECK_FALSE(lalloc_region_active());
+        CHECK(lalloc_get_stats().region_bytes == 0);
+    }
+
+    lalloc_region_begin();
+    lval* result = lval_eval(env, lispy_parse("(extend xs)"));
+    CHECK(lval_eq(result, expected));
+    lval_del(result);
+    lalloc_region_end();
+
+    lalloc_set_region_mode(0);
+
+    lval* defined = lval_eval(env, lispy_parse("ys"));
+    CHECK(lval_eq(defined, expected));
+    lval_del(defined);
+
+    lval_del(expected);
+    lenv_del(env);
+}
+
+TEST_CASE("Arithmetic reduces any number of operands", "[builtin]")
+{
+    std::string sum = "(+";
+    std::string product = "(eval (join {*} (list";
+
+    for (int i = 1; i <= 10000; i++) {
+        sum += " " + std::to_string(i);
+        product += i % 2 ? " 1" : " -1";
+    }
+
+    sum += ")";
+    product += ")))";
+
+    CHECK(lispy_evaluates_to(sum.c_str(), "50005000"));
+    CHECK(lispy_evaluates_to(product.c_str(), "1"));
+    CHECK(lispy_evaluates_to("(list (- 5) (- 10 1 2 3) (/ 100 5 2) (* 2 3 4))", "{-5 4 10 24}"));
+    CHECK(lispy_fails_with("(+ 1 2 {3} 4)", "Function '+' passed incorrect type for argument 2. Got Q-Expression, Expected Number."));
+    CHECK(lispy_fails_with("(/ 1 0 {x})", "Function '/' passed incorrect type for argument 2. Got Q-Expression, Expected Number."));
+    CHECK(lispy_fails_with("(/ 1 0 2)", "Division by zero!"));
+    CHECK(lispy_fails_with("(> 1 2 3)", "Function '>' passed incorrect number of arguments. Got 3, Expected 2."));
+    CHECK(lispy_fails_with("(== 1)", "Function '==' passed incorrect number of arguments. Got 1, Expected 2."));
+
+    lval* difference = builtin_op(NULL, lval_add(lval_add(lval_sexpr(), lval_num(7)), lval_num(2)), "-");
+    CHECK(lval_num_value(difference) == 5);
+    lval_del(difference);
+
+    lval* ordered = builtin_ord(NULL, lval_add(lval_add(lval_sexpr(), lval_num(7)), lval_num(2)), ">=");
+    CHECK(lval_num_value(ordered) == 1);
+    lval_del(ordered);
+}
+
+TEST_CASE("Global lookups are cached until a redefinition", "[env]")
+{
+    const char* const redefined[] = {
+        "(def {k} 1) (fun {f x} {+ x k}) (f 1) (f 1) (def {k} 10) (f 1)",
+        "(def {k} 1) (fun {f x} {+ x k}) (f 1) (f 1) (= {k} 10) (f 1)",
+        "(def {k} 1) (fun {f x} {+ x k}) (f 1) (fun {g k} {f 1}) (list (g 10) (f 1))",
+        "(fun {h x} {+ x 1}) (fun {f x} {h x}) (f 1) (f 1) (fun {h x} {+ x 10}) (f 1)",
+    };
+
+    const char* const expected[] = { "11", "11", "{11 2}", "11" };
+
+    for (const lispy_config& config : { tree_walker, native_code }) {
+        lispy_modes modes(config);
+
+        for (unsigned i = 0; i < sizeof(redefined) / sizeof(redefined[0]); i++) {
+            INFO(redefined[i]);
+            CAPTURE(config.vm);
+            CHECK(lispy_evaluates_to(redefined[i], expected[i]));
+        }
+    }
+}
+
+TEST_CASE("cache-stats counts cached lookups", "[env]")
+{
+    lispy_modes modes(tree_walker);
+
+    lenv_cache_stats before = lenv_get_cache_stats();
+    CHECK(lispy_evaluates_to("(def {k} 1) (fun {f n} {if (== n 0) {k} {f (- n 1)}}) (f 100)", "1"));
+    lenv_cache_stats after = lenv_get_cache_stats();
+
+    CHECK(after.cache_hits >= before.cache_hits + 100);
+
+    lval* stats = lispy_run("(cache-stats ())");
+    REQUIRE(lval_type(stats) == LVAL_QEXPR);
+    REQUIRE(stats->count == 8);
+    lval* name = lispy_parse("cache-hits");
+    CHECK(lval_eq(stats->cell[2], name));
+    lval_del(name);
+    CHECK(lval_num_value(stats->cell[3]) >= static_cast<long>(after.cache_hits)); // NOLINT(google-runtime-int)
+    lval_del(stats);
+}
+
+TEST_CASE("select and case without clauses report an error", "[prelude]")
+{
+    for (const lispy_config& config : { native_code, lispy_prelude }) {
+        lispy_modes modes(config);
+        CAPTURE(config.native);
+
+        lenv* env = lenv_new();
+        lenv_add_builtins(env);
+        lval_del(builtin_load(env, lval_add(lval_sexpr(), lval_str(LISPY_PRELUDE_PATH))));
+
+        lval* name = lispy_parse("select");
+        lval* select = lenv_get(env, name);
+        lval* result = lval_call(env, select, lval_sexpr());
+        lval* err = lval_err("No Selection Found");
+        CHECK(lval_eq(result, err));
+
+        lval_del(err);
+        lval_del(result);
+        lval_del(select);
+        lval_del(name);
+        lenv_del(env);
+
+        CHECK(lispy_fails_with("(case 1)", "No Case Found"));
+        CHECK(lispy_fails_with("(select {(== 1 2) 1})", "No Selection Found"));
+    }
+}